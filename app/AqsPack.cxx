@@ -0,0 +1,57 @@
+#include "InterfaceAqs.hxx"
+#include "AqsArchive.hxx"
+
+#include <iostream>
+#include <thread>
+
+#include "CmdLineParser.h"
+
+int main(int argc, char **argv) {
+    // inti CLI module
+    CmdLineParser clParser;
+    clParser.setIsUnixGnuMode(true);
+    clParser.setIsFascist((true));
+
+    // define CLI
+    clParser.addOption("input_file", {"-i", "--input"}, "Input AQS file name");
+    clParser.addOption("output_path", {"-o", "--output"}, "Output path");
+    clParser.addOption("verbose", {"-v", "--verbose"}, "Verbosity level");
+    clParser.addOption("threads", {"-j", "--threads"}, "Number of threads compressing the blocks, all cores by default");
+    clParser.addOption("lz4_level", {"--lz4-level"}, "LZ4 level, LZ4 HC from 3 on");
+
+    clParser.addTriggerOption("help", {"-h", "--help"}, "Print usage");
+
+    // do parsing
+    clParser.parseCmdLine(argc, argv);
+
+    if (clParser.isOptionTriggered("help")) {
+        std::cout << clParser.getConfigSummary();
+        exit(0);
+    }
+
+    auto fileName = clParser.getOptionVal<std::string>("input_file", "", 0);
+    auto outPath = clParser.getOptionVal<std::string>("output_path", "", 0);
+    auto verbose = clParser.getOptionVal<int>("verbose", 1, 0);
+    auto nThreads = clParser.getOptionVal<int>("threads", std::thread::hardware_concurrency(), 0);
+    auto lz4Level = clParser.getOptionVal<int>("lz4_level", 1, 0);
+
+    // the events are located by the usual scan, or taken from the sidecar index
+    InterfaceAQS interface;
+    if (!interface.Initialise(fileName, verbose)) {
+        std::cerr << "Interface initialisation fails. Exit" << std::endl;
+        exit(1);
+    }
+    int lastEvent;
+    interface.Scan(-1, true, lastEvent);
+
+    auto name = fileName.substr(fileName.find_last_of('/') + 1);
+    auto archive = outPath + name + ".lz4";
+    if (!AqsArchive::Write(fileName, interface.GetEventRecords(), lastEvent, archive, lz4Level, nThreads)) {
+        std::cerr << "Archive " << archive << " could not be written." << std::endl;
+        std::cerr << "File probably exists. Prevent overwriting" << std::endl;
+        exit(1);
+    }
+    if (verbose > 0)
+        std::cout << "Archive written to " << archive << std::endl;
+    return 0;
+}
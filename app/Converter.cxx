@@ -1,4 +1,7 @@
 #include "InterfaceFactory.hxx"
+#include "DecoderPool.hxx"
+#include "MidasPipeline.hxx"
+#include "RootClusterProcessor.hxx"
 #include "Output.hxx"
 
 #include <iostream>
@@ -6,6 +9,7 @@
 #include "CmdLineParser.h"
 
 #include "TString.h"
+#include "TROOT.h"
 
 int main(int argc, char **argv) {
 //    Param param;
@@ -21,9 +25,20 @@ int main(int argc, char **argv) {
     clParser.addOption("verbose", {"-v", "--verbose"}, "Verbosity level");
     clParser.addOption("tracker", {"-s", "--silicon"}, "Add silicon tracker info");
     clParser.addOption("nEventsFile", {"-n", "--nEventsFile"}, "Number of events to process");
+    clParser.addOption("threads", {"-j", "--threads"}, "Number of threads decoding the events");
+    clParser.addOption("io_depth", {"--io-depth"}, "Number of blocks read in advance, enables the read-ahead");
+    clParser.addOption("io_block", {"--io-block"}, "Size of the read-ahead blocks in kB");
+    clParser.addTriggerOption("io_direct", {"--io-direct"}, "Read-ahead bypasses the page cache (O_DIRECT)");
+    clParser.addOption("io_threads", {"--io-threads"}, "Number of threads decompressing the LZ4 blocks of the input");
+    clParser.addOption("memory", {"--memory"}, "Memory ceiling in MB of the Midas events converted by several threads");
+    clParser.addOption("root_cache", {"--root-cache"}, "TTreeCache size in MB of ROOT inputs, a cluster by default, -1 disables it");
+    clParser.addOption("root_threads", {"--root-threads"}, "Number of ROOT implicit multithreading threads decompressing the baskets");
+    clParser.addTriggerOption("root_prefetch", {"--root-prefetch"}, "Read the next cluster of ROOT inputs in the background");
 
     clParser.addTriggerOption("text", {"--text"}, "Convert to text file");
     clParser.addOption("array", {"--array"}, "Convert to 3D array");
+    clParser.addTriggerOption("midas", {"--midas"}, "Convert to Midas .mid.lz4 file");
+    clParser.addOption("lz4_level", {"--lz4-level"}, "LZ4 level of the Midas output, LZ4 HC from 3 on");
     clParser.addOption("card", {"-c", "--card"}, "Specify the particular card that will be converted.");
 
     clParser.addTriggerOption("help", {"-h", "--help"}, "Print usage");
@@ -43,13 +58,35 @@ int main(int argc, char **argv) {
 
     auto nEventsRead = clParser.getOptionVal<uint64_t>("nEventsFile", 0, 0);
     auto verbose = clParser.getOptionVal<int>("verbose", 1, 0);
+    auto nThreads = clParser.getOptionVal<int>("threads", 1, 0);
+
+    ReadAheadOptions io;
+    io.depth = clParser.getOptionVal<int>("io_depth", 0, 0);
+    io.blockSize = clParser.getOptionVal<size_t>("io_block", io.blockSize / 1024, 0) * 1024;
+    io.direct = clParser.isOptionTriggered("io_direct");
+    io.threads = clParser.getOptionVal<int>("io_threads", 0, 0);
+    auto memory = clParser.getOptionVal<size_t>("memory", 1024, 0) << 20;
+
+    // the tracker data comes from the silicon tracker file, only the events are read
+    RootReadOptions root;
+    // the size is given in MB, -1 disables the cache
+    root.cacheSize = clParser.getOptionVal<Long64_t>("root_cache", 0, 0);
+    if (root.cacheSize > 0)
+        root.cacheSize *= 1 << 20;
+    root.threads = clParser.getOptionVal<int>("root_threads", 0, 0);
+    root.prefetch = clParser.isOptionTriggered("root_prefetch");
+    root.readTracker = false;
 
     bool useArray = clParser.isOptionTriggered("array");
     bool useText = clParser.isOptionTriggered("text");
+    bool useMidas = clParser.isOptionTriggered("midas");
+    auto lz4Level = clParser.getOptionVal<int>("lz4_level", 1, 0);
     auto card = clParser.getOptionVal<int>("card", 0, 0);
 
     // define the proper interface to read it
     std::shared_ptr<InterfaceBase> interface = InterfaceFactory::get(fileName);
+    interface->SetReadAhead(io);
+    interface->SetRootOptions(root);
     if (!interface->Initialise(fileName, verbose)) {
         std::cerr << "Interface initialisation fails. Exit" << std::endl;
         exit(1);
@@ -59,11 +96,22 @@ int main(int argc, char **argv) {
     auto tracker = std::make_shared<InterfaceTracker>();
     auto read_tracker = tracker->Initialise(trackerName, verbose);
 
+    // compressed and piped AQS inputs are decompressed by the reader thread and can't be scanned
+    auto aqs = std::dynamic_pointer_cast<InterfaceAQS>(interface);
+    bool stream = aqs && aqs->IsStream();
+    if (stream && read_tracker) {
+        std::cerr << "The tracker data needs the scan of the input, not possible with " << fileName << std::endl;
+        exit(1);
+    }
+
     // extract the file name from the input
     TString out_file = OutputBase::getFileName(outPath, fileName);
     if (useText){
         out_file.ReplaceAll(".root", ".txt");
     }
+    if (useMidas) {
+        out_file.ReplaceAll(".root", ".mid.lz4");
+    }
 
     // Select the output format
     std::shared_ptr<OutputBase> output;
@@ -72,11 +120,58 @@ int main(int argc, char **argv) {
         output->SetCard(card);
     } else if (useText) {
         output = std::make_shared<OutputText>();
+    } else if (useMidas) {
+        // the blocks are compressed by as many threads as decode the events
+        auto midas = std::make_shared<OutputMidas>();
+        midas->SetCompression(lz4Level, nThreads);
+        output = midas;
     }
     else {
         output = std::make_shared<OutputTRawEvent>();
     }
     output->Initialise(out_file, read_tracker);
+    // the array and Midas outputs take the 16-bit compact events, read without any TRawHit
+    bool compact = useArray || useMidas;
+
+    // without the tracker and the thread pool the events are read in one pass in the file order,
+    // with several threads the Midas events go through the pipeline in one pass as well and the
+    // AQS streams are decoded by one thread
+    bool midasPipeline = !read_tracker && nThreads > 1 && std::dynamic_pointer_cast<InterfaceMidas>(interface);
+    if (!read_tracker && (nThreads <= 1 || midasPipeline || stream)) {
+        if (verbose == 1)
+            std::cout << "Doing conversion" << std::endl;
+        std::unique_ptr<MidasPipeline> pipeline;
+        if (midasPipeline) {
+            ROOT::EnableThreadSafety();
+            pipeline.reset(new MidasPipeline(fileName, nThreads, io, memory));
+            pipeline->Start(nEventsRead);
+        }
+        // without the pipeline one event and its hits are recycled, they are not deleted by Fill
+        PooledEvent reuse;
+        TRawEvent* event = &reuse;
+        CompactEvent packed;
+        bool readPacked = compact && !pipeline;
+        output->SetEventOwner(pipeline != nullptr);
+        uint64_t i = 0;
+        while ((nEventsRead == 0 || i < nEventsRead) &&
+            (pipeline ? pipeline->Next(event) :
+             readPacked ? interface->NextEvent(packed) : interface->NextEvent(reuse))) {
+            if (verbose > 1)
+                std::cout << "Working on " << i << std::endl;
+            if (readPacked)
+                output->AddEvent(packed);
+            else
+                output->AddEvent(event);
+            output->Fill();
+            ++i;
+        }
+        output->Finilise();
+        if (verbose > 0)
+            std::cout << "\nConversion done, " << i << " events" << std::endl;
+        if (pipeline && verbose > 0)
+            pipeline->Print();
+        return 0;
+    }
 
     // define the output events number
     uint64_t nEventsFile;
@@ -92,9 +187,26 @@ int main(int argc, char **argv) {
     if (nEventsRead > 0) {
         nEventsFile = std::min(nEventsFile, nEventsRead);
     }
+
+    // with several threads the events are decoded in parallel and written in the file order
+    std::unique_ptr<DecoderPool> pool;
+    if (nThreads > 1) {
+        ROOT::EnableThreadSafety();
+        pool.reset(new DecoderPool(*interface, fileName, nThreads, io, root));
+        // a cluster of a ROOT input is decompressed by one thread instead of each thread reading it
+        std::vector<uint64_t> batches;
+        if (std::dynamic_pointer_cast<InterfaceROOT>(interface) || std::dynamic_pointer_cast<InterfaceRawEvent>(interface))
+            batches = RootClusterProcessor::GetClusterStarts(fileName);
+        pool->Start(nEventsFile, batches);
+    }
+
     if (verbose == 1)
         std::cout << "Doing conversion" << "\n[                     ]\r[" << std::flush;
 
+    // the events of the pool are owned by the output, without it one event is recycled
+    PooledEvent reuse;
+    CompactEvent packed;
+    output->SetEventOwner(pool != nullptr);
     for (long int i = 0; i < nEventsFile; ++i) {
         if (verbose > 1)
             std::cout << "Working on " << i << std::endl;
@@ -102,7 +214,15 @@ int main(int argc, char **argv) {
             if (i % (nEventsFile / 20) == 0)
                 std::cout << "#" << std::flush;
         }
-        output->AddEvent(interface->GetEvent(i));
+        if (pool) {
+            output->AddEvent(pool->Next());
+        } else if (compact) {
+            interface->GetEvent(i, packed);
+            output->AddEvent(packed);
+        } else {
+            interface->GetEvent(i, reuse);
+            output->AddEvent(&reuse);
+        }
 
         if (read_tracker) {
             std::vector<float> tracker_data;
@@ -10,6 +10,7 @@
 #include <signal.h> // signal()
 
 #include <string>
+#include <algorithm> // std::find()
 
 #undef NDEBUG // working assert() is required by this program. K.O.
 
@@ -575,6 +576,18 @@ static size_t Align8(size_t size)
 }
 
 TMEvent* TMReadEvent(TMReaderInterface* reader)
+{
+   TMEvent* e = new TMEvent;
+
+   if (!TMReadEventInto(reader, *e)) {
+      delete e;
+      return NULL;
+   }
+
+   return e;
+}
+
+bool TMReadEventInto(TMReaderInterface* reader, TMEvent& event)
 {
    bool gOnce = true;
    if (gOnce) {
@@ -584,7 +597,7 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
       assert(sizeof(uint32_t)==4);
    }
    
-   TMEvent* e = new TMEvent;
+   TMEvent* e = &event;
 
    e->Reset();
 
@@ -594,15 +607,13 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
    int rd = reader->Read(event_header, event_header_size);
 
    if (rd < 0) { // read error
-      delete e;
-      return NULL;
+      return false;
    } else if (rd == 0) { // end of file
-      delete e;
-      return NULL;
+      return false;
    } else if (rd != event_header_size) { // truncated data in file
       fprintf(stderr, "TMReadEvent: error: read %d shorter than event header size %d\n", (int)rd, (int)event_header_size);
       e->error = true;
-      return e;
+      return true;
    }
 
    e->event_id      = GetU16(event_header+0);
@@ -622,6 +633,7 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
 
    size_t to_read = e->data_size;
 
+   // the capacity of a reused event is kept by Reset(), the new bytes are not zeroed
    e->data.resize(event_header_size + to_read);
 
    memcpy(&e->data[0], event_header, event_header_size);
@@ -629,15 +641,14 @@ TMEvent* TMReadEvent(TMReaderInterface* reader)
    rd = reader->Read(&e->data[event_header_size], to_read);
 
    if (rd < 0) { // read error
-      delete e;
-      return NULL;
+      return false;
    } else if (rd != (int)to_read) { // truncated data in file
       fprintf(stderr, "TMReadEvent: error: short read %d instead of %d\n", (int)rd, (int)to_read);
       e->error = true;
-      return e;
+      return true;
    }
 
-   return e;
+   return true;
 }
 
 void TMWriteEvent(TMWriterInterface* writer, const TMEvent* event)
@@ -689,6 +700,7 @@ void TMEvent::Reset()
    bank_header_flags  = 0;
 
    banks.clear();
+   bank_directory.clear();
    data.clear();
 
    found_all_banks = false;
@@ -849,10 +861,12 @@ void TMEvent::AddBank(const char* bank_name, int tid, const char* buf, size_t si
    if (found_all_banks) {
       TMBank b;
       b.name = bank_name;
+      b.tag = TMBankTag(bank_name);
       b.type = tid;
       b.data_size = size;
       b.data_offset = end_of_event_offset + 4*4;
       banks.push_back(b);
+      bank_directory.clear(); // rebuilt by the next lookup
    }
 }
 
@@ -920,17 +934,10 @@ static size_t FindNextBank(TMEvent* e, size_t pos, TMBank** pb)
       return 0;
    }
 
-   size_t ibank = e->banks.size();
-   e->banks.resize(ibank+1);
-
-   TMBank* b = &e->banks[ibank];
+   TMBank bank;
+   TMBank* b = &bank;
 
-   b->name.resize(4);
-   b->name[0] = e->data[pos+0];
-   b->name[1] = e->data[pos+1];
-   b->name[2] = e->data[pos+2];
-   b->name[3] = e->data[pos+3];
-   b->name[4] = 0;
+   b->tag = TMBankTag(&e->data[pos]); // the bytes after a short name are undefined
 
    size_t data_offset = 0;
 
@@ -977,6 +984,16 @@ static size_t FindNextBank(TMEvent* e, size_t pos, TMBank** pb)
       return 0;
    }
 
+   // the banks which are not selected are only stepped over
+   if (!e->bank_selection.empty() &&
+       std::find(e->bank_selection.begin(), e->bank_selection.end(), b->tag) == e->bank_selection.end())
+      return npos;
+
+   b->name.assign(&e->data[pos], strnlen(&e->data[pos], 4));
+
+   e->banks.push_back(bank);
+   b = &e->banks.back();
+
    if (pb)
       *pb = b;
 
@@ -1036,15 +1053,54 @@ const char* TMEvent::GetBankData(const TMBank* b) const
 }
 
 TMBank* TMEvent::FindBank(const char* bank_name)
+{
+   return FindBank(bank_name ? TMBankTag(bank_name) : 0);
+}
+
+static size_t DirectorySlot(uint32_t tag, size_t mask)
+{
+   return (tag * 0x9E3779B1u) & mask;
+}
+
+static void BuildDirectory(TMEvent* e)
+{
+   // open addressing with linear probing, at most half full
+   size_t size = 8;
+   while (size < 2*e->banks.size())
+      size *= 2;
+   e->bank_directory.assign(size, 0);
+   for (unsigned i=0; i<e->banks.size(); i++) {
+      size_t slot = DirectorySlot(e->banks[i].tag, size - 1);
+      while (e->bank_directory[slot])
+         slot = (slot + 1) & (size - 1);
+      e->bank_directory[slot] = i + 1;
+   }
+}
+
+TMBank* TMEvent::FindBank(uint32_t tag)
 {
    if (error)
       return NULL;
 
+   // once all banks are found, they are looked up in the directory
+
+   if (found_all_banks && tag) {
+      if (bank_directory.empty())
+         BuildDirectory(this);
+      size_t mask = bank_directory.size() - 1;
+      for (size_t slot = DirectorySlot(tag, mask); bank_directory[slot]; slot = (slot + 1) & mask) {
+         TMBank* b = &banks[bank_directory[slot] - 1];
+         if (b->tag == tag)
+            return b;
+      }
+      return NULL;
+   }
+
    // if we already found this bank, return it
 
-   if (bank_name)
+   if (tag)
       for (unsigned i=0; i<banks.size(); i++) {
-         if (banks[i].name == bank_name)
+         if (banks[i].tag == tag)
             return &banks[i];
       }
 
@@ -1065,8 +1121,8 @@ TMBank* TMEvent::FindBank(const char* bank_name)
       pos = FindNextBank(this, pos, &b);
       bank_scan_position = pos;
       //printf("pos %d, b %p\n", pos, b);
-      if (pos>0 && b && bank_name) {
-         if (b->name == bank_name)
+      if (pos>0 && b && tag) {
+         if (b->tag == tag)
             return b;
       }
    }
@@ -1076,14 +1132,21 @@ TMBank* TMEvent::FindBank(const char* bank_name)
    return NULL;
 }
 
+void TMEvent::SelectBanks(const std::vector<uint32_t>& tags)
+{
+   bank_selection = tags;
+}
+
 void TMEvent::FindAllBanks()
 {
    if (found_all_banks)
       return;
 
-   FindBank(NULL);
+   FindBank((uint32_t)0);
 
    assert(found_all_banks);
+
+   BuildDirectory(this);
 }
 
 void TMEvent::PrintHeader() const
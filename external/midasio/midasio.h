@@ -3,7 +3,9 @@
 #ifndef MIDASIO_H
 #define MIDASIO_H
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <stdint.h>
 
@@ -40,15 +42,37 @@ MIDAS Data Type Definitions                             min      max    */
 #define TID_LAST     19       /**< end of TID list indicator            */
 #endif
 
+/// bank name packed into an integer, the first character in the lowest byte
+constexpr uint32_t TMBankTag(const char* name, int i = 0)
+{
+   return (i == 4 || name[i] == 0) ? 0 : ((uint32_t)(unsigned char)name[i] << (8*i)) | TMBankTag(name, i + 1);
+}
+
 class TMBank
 {
  public:
    std::string name;            ///< bank name, 4 characters max
+   uint32_t    tag  = 0;        ///< bank name packed by TMBankTag()
    uint32_t    type = 0;        ///< type of bank data, enum of TID_xxx
    uint32_t    data_size   = 0; ///< size of bank data in bytes
    size_t      data_offset = 0; ///< offset of data for this bank in the event data[] container
 };
 
+/// Allocator leaving the new elements of a vector uninitialized.
+/// The event data is always overwritten after a resize, zero-filling it is wasted.
+template <typename T>
+class TMUninitializedAllocator : public std::allocator<T>
+{
+ public:
+   template <typename U> struct rebind { typedef TMUninitializedAllocator<U> other; };
+
+   TMUninitializedAllocator() = default;
+   template <typename U> TMUninitializedAllocator(const TMUninitializedAllocator<U>&) {}
+
+   template <typename U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+   template <typename U, typename... Args> void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+};
+
 class TMEvent
 {
 public: // event data
@@ -64,12 +88,14 @@ public: // event data
    uint32_t bank_header_flags;  ///< flags from the MIDAS event bank header
 
    std::vector<TMBank> banks;   ///< list of MIDAS banks, fill using FindAllBanks()
-   std::vector<char> data;      ///< MIDAS event bytes
+   std::vector<char, TMUninitializedAllocator<char>> data; ///< MIDAS event bytes
 
 public: // internal data
 
    bool found_all_banks;        ///< all the banks in the event data have been discovered
    size_t bank_scan_position;   ///< location where scan for MIDAS banks was last stopped
+   std::vector<int> bank_directory;     ///< hash table of the bank tags to their index in banks + 1, built once all banks are found
+   std::vector<uint32_t> bank_selection; ///< tags of the banks to be kept by the scan, empty to keep all, not cleared by Reset()
 
 public: // constructors
    TMEvent(); // ctor
@@ -82,6 +108,8 @@ public: // constructors
 public: // read data
    void FindAllBanks();                      ///< scan the MIDAS event, find all data banks
    TMBank* FindBank(const char* bank_name);  ///< scan the MIDAS event
+   TMBank* FindBank(uint32_t tag);           ///< scan the MIDAS event, the name is packed by TMBankTag()
+   void SelectBanks(const std::vector<uint32_t>& tags); ///< only the banks with these tags are recorded by the next scans, the others are skipped
    char* GetEventData();                     ///< get pointer to MIDAS event data
    const char* GetEventData() const;         ///< get pointer to MIDAS event data
    char* GetBankData(const TMBank*);         ///< get pointer to MIDAS data bank
@@ -131,6 +159,7 @@ TMReaderInterface* TMNewReader(const char* source);
 TMWriterInterface* TMNewWriter(const char* destination);
 
 TMEvent* TMReadEvent(TMReaderInterface* reader);
+bool TMReadEventInto(TMReaderInterface* reader, TMEvent& event); // reuse the event and the capacity of its data, false at end of file or on read error
 void TMWriteEvent(TMWriterInterface* writer, const TMEvent* event);
 
 extern bool TMTraceCtorDtor;
@@ -0,0 +1,269 @@
+#include "AqsArchive.hxx"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "mlz4.h"
+#include "mlz4hc.h"
+#include "mxxhash.h"
+
+static const char kMagic[8] = {'A', 'Q', 'S', 'A', 'R', 'C', '0', '1'};
+static const uint32_t kLz4Magic = 0x184D2204;
+/// The index is stored in one of the skippable frames ignored by the LZ4 decoders
+static const uint32_t kIndexMagic = 0x184D2A5A;
+/// Levels from which LZ4 HC is used
+static const int kHighCompression = 3;
+
+struct AqsArchive::Header {
+    char magic[8];
+    uint64_t data_size;
+    uint64_t n_blocks;
+    uint64_t n_events;
+    int64_t last_event;
+};
+
+/// End of the archive, locates the index frame
+struct Trailer {
+    uint64_t index_offset;
+    char magic[8];
+};
+
+/// Block being compressed by the workers
+struct CompressSlot {
+    std::vector<char> in;
+    std::vector<char> out;
+    int compressed{0};
+    bool done{true};
+};
+
+//******************************************************************************
+AqsArchive::~AqsArchive() {
+//******************************************************************************
+    if (_file)
+        fclose(_file);
+}
+
+//******************************************************************************
+bool AqsArchive::Write(const std::string& aqs_file,
+                       const std::vector<AqsEventRecord>& events,
+                       int last_event,
+                       const std::string& archive,
+                       int level,
+                       int threads) {
+//******************************************************************************
+    struct stat st{};
+    if (stat(aqs_file.c_str(), &st) != 0)
+        return false;
+    uint64_t data_size = st.st_size;
+
+    // a block ends at the last event starting before the block size, or at the block size
+    // within an event larger than it
+    std::vector<uint64_t> bounds{0};
+    size_t next = 0;
+    while (bounds.back() < data_size) {
+        auto start = bounds.back();
+        auto end = std::min<uint64_t>(start + kBlockSize, data_size);
+        if (end < data_size) {
+            while (next < events.size() && (uint64_t)events[next].offset <= end)
+                ++next;
+            if (next > 0 && (uint64_t)events[next - 1].offset > start)
+                end = events[next - 1].offset;
+        }
+        bounds.push_back(end);
+    }
+
+    FILE* in = fopen(aqs_file.c_str(), "rb");
+    if (!in)
+        return false;
+    FILE* out = fopen(archive.c_str(), "wbx");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    // version 1, independent blocks without checksums, 4 MB blocks
+    unsigned char frame[7];
+    memcpy(frame, &kLz4Magic, 4);
+    frame[4] = 0x60;
+    frame[5] = 0x70;
+    frame[6] = (XXH32(frame + 4, 2, 0) >> 8) & 0xFF;
+    bool ok = fwrite(frame, sizeof(frame), 1, out) == 1;
+    uint64_t offset = sizeof(frame);
+
+    auto compress = [level](CompressSlot& slot) {
+        int bound = MLZ4_compressBound(slot.in.size());
+        slot.out.resize(bound);
+        if (level >= kHighCompression)
+            slot.compressed = MLZ4_compress_HC(slot.in.data(), slot.out.data(), slot.in.size(), bound, level);
+        else
+            slot.compressed = MLZ4_compress_default(slot.in.data(), slot.out.data(), slot.in.size(), bound);
+    };
+
+    // the blocks are read in order, compressed by the workers and written in order
+    std::vector<CompressSlot> slots(std::max(2 * threads, 1));
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable compressed;
+    std::deque<CompressSlot*> queue;
+    bool stop = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; threads > 1 && i < threads; ++i) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                work.wait(lock, [&]() { return stop || !queue.empty(); });
+                if (stop)
+                    return;
+                auto slot = queue.front();
+                queue.pop_front();
+                lock.unlock();
+                compress(*slot);
+                lock.lock();
+                slot->done = true;
+                compressed.notify_all();
+            }
+        });
+    }
+
+    std::vector<AqsArchiveBlock> blocks;
+    auto write = [&](size_t k) {
+        auto& slot = slots[k % slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            compressed.wait(lock, [&slot]() { return slot.done; });
+        }
+        // a block that doesn't shrink is stored as it is
+        bool stored = slot.compressed <= 0 || (size_t)slot.compressed >= slot.in.size();
+        uint32_t size = stored ? slot.in.size() : slot.compressed;
+        AqsArchiveBlock block{offset, bounds[k], (uint32_t)slot.in.size(), stored ? size | 0x80000000 : size};
+        ok = ok && fwrite(&block.stored_size, 4, 1, out) == 1 &&
+            fwrite(stored ? slot.in.data() : slot.out.data(), size, 1, out) == 1;
+        offset += 4 + size;
+        blocks.push_back(block);
+    };
+
+    size_t submitted = 0;
+    size_t written = 0;
+    for (; ok && submitted + 1 < bounds.size(); ++submitted) {
+        if (submitted - written == slots.size())
+            write(written++);
+        auto& slot = slots[submitted % slots.size()];
+        slot.in.resize(bounds[submitted + 1] - bounds[submitted]);
+        ok = ok && fread(slot.in.data(), slot.in.size(), 1, in) == 1;
+        if (!ok)
+            break;
+        if (workers.empty()) {
+            compress(slot);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.done = false;
+            queue.push_back(&slot);
+        }
+        work.notify_one();
+    }
+    while (written < submitted)
+        write(written++);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    fclose(in);
+
+    // end mark, then the index frame and the trailer locating it
+    uint32_t end_mark = 0;
+    ok = ok && fwrite(&end_mark, 4, 1, out) == 1;
+    Trailer trailer{offset + 4, {}};
+    memcpy(trailer.magic, kMagic, sizeof(kMagic));
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.data_size = data_size;
+    header.n_blocks = blocks.size();
+    header.n_events = events.size();
+    header.last_event = last_event;
+    uint32_t frame_size = sizeof(header) + blocks.size() * sizeof(AqsArchiveBlock) +
+        events.size() * sizeof(AqsEventRecord) + sizeof(trailer);
+    ok = ok && fwrite(&kIndexMagic, 4, 1, out) == 1 && fwrite(&frame_size, 4, 1, out) == 1 &&
+        fwrite(&header, sizeof(header), 1, out) == 1 &&
+        fwrite(blocks.data(), sizeof(AqsArchiveBlock), blocks.size(), out) == blocks.size() &&
+        fwrite(events.data(), sizeof(AqsEventRecord), events.size(), out) == events.size() &&
+        fwrite(&trailer, sizeof(trailer), 1, out) == 1;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok)
+        remove(archive.c_str());
+    return ok;
+}
+
+//******************************************************************************
+bool AqsArchive::Open(const std::string& archive) {
+//******************************************************************************
+    _file = fopen(archive.c_str(), "rb");
+    if (!_file)
+        return false;
+
+    Trailer trailer{};
+    uint32_t frame[2];
+    Header header{};
+    bool ok = fseeko(_file, -(off_t)sizeof(trailer), SEEK_END) == 0 &&
+        fread(&trailer, sizeof(trailer), 1, _file) == 1 &&
+        memcmp(trailer.magic, kMagic, sizeof(kMagic)) == 0 &&
+        fseeko(_file, trailer.index_offset, SEEK_SET) == 0 &&
+        fread(frame, sizeof(frame), 1, _file) == 1 && frame[0] == kIndexMagic &&
+        fread(&header, sizeof(header), 1, _file) == 1 &&
+        memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        frame[1] == sizeof(header) + header.n_blocks * sizeof(AqsArchiveBlock) +
+            header.n_events * sizeof(AqsEventRecord) + sizeof(trailer);
+    if (ok) {
+        _blocks.resize(header.n_blocks);
+        _events.resize(header.n_events);
+        _lastEvent = header.last_event;
+        ok = fread(_blocks.data(), sizeof(AqsArchiveBlock), _blocks.size(), _file) == _blocks.size() &&
+            fread(_events.data(), sizeof(AqsEventRecord), _events.size(), _file) == _events.size();
+    }
+    if (!ok) {
+        _blocks.clear();
+        _events.clear();
+        fclose(_file);
+        _file = nullptr;
+    }
+    return ok;
+}
+
+//******************************************************************************
+size_t AqsArchive::FindBlock(uint64_t offset) const {
+//******************************************************************************
+    auto next = std::upper_bound(_blocks.begin(), _blocks.end(), offset,
+                                 [](uint64_t value, const AqsArchiveBlock& block) {
+                                     return value < block.data_offset;
+                                 });
+    return next == _blocks.begin() ? 0 : next - _blocks.begin() - 1;
+}
+
+//******************************************************************************
+long AqsArchive::ReadBlock(size_t i, std::vector<uint16_t>& datums) {
+//******************************************************************************
+    const auto& block = _blocks[i];
+    size_t size = block.stored_size & 0x7FFFFFFF;
+    bool stored = block.stored_size & 0x80000000;
+    datums.resize((block.data_size + 1) / sizeof(uint16_t));
+    auto dst = reinterpret_cast<char*>(datums.data());
+    _error = fseeko(_file, block.file_offset + 4, SEEK_SET) != 0;
+    if (!_error && stored) {
+        _error = size != block.data_size || fread(dst, size, 1, _file) != 1;
+    } else if (!_error) {
+        _in.resize(size);
+        _error = fread(_in.data(), size, 1, _file) != 1 ||
+            MLZ4_decompress_safe(_in.data(), dst, size, block.data_size) != (int)block.data_size;
+    }
+    return _error ? -1 : block.data_size / sizeof(uint16_t);
+}
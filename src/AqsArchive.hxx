@@ -0,0 +1,67 @@
+#ifndef DAQ_READER_SRC_AQSARCHIVE_HXX_
+#define DAQ_READER_SRC_AQSARCHIVE_HXX_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "AqsIndex.hxx"
+
+/// Compressed block of an archive
+struct AqsArchiveBlock {
+    /// byte offset of the block size word in the archive
+    uint64_t file_offset;
+    /// byte offset of the block content in the AQS data
+    uint64_t data_offset;
+    uint32_t data_size;
+    /// LZ4 block size word, the high bit flags a block stored without compression
+    uint32_t stored_size;
+};
+
+/// Seekable LZ4 archive of an AQS file, <file>.aqs.lz4
+/// The data is a standard LZ4 frame of independent blocks, so lz4 -d gives back the
+/// AQS file. The blocks start at the events, except within the events larger than
+/// a block, and the frame is followed by a skippable frame with the block table and
+/// the event index. An event is read by decompressing the block owning its offset.
+class AqsArchive {
+ public:
+    ~AqsArchive();
+
+    /// Compress the AQS file with its event index into the archive.
+    /// The blocks are compressed by the given number of threads, from level 3 on with LZ4 HC.
+    /// An existing archive is not overwritten
+    static bool Write(const std::string& aqs_file,
+                      const std::vector<AqsEventRecord>& events,
+                      int last_event,
+                      const std::string& archive,
+                      int level,
+                      int threads);
+
+    /// Read the index of the archive, false if the file is not an archive
+    bool Open(const std::string& archive);
+    const std::vector<AqsEventRecord>& GetEvents() const { return _events; }
+    /// The last event number seen during the scan of the AQS file
+    int GetLastEvent() const { return _lastEvent; }
+    size_t GetNBlocks() const { return _blocks.size(); }
+    const AqsArchiveBlock& GetBlock(size_t i) const { return _blocks[i]; }
+    /// Block owning the byte offset of the AQS data
+    size_t FindBlock(uint64_t offset) const;
+    /// Decompress the block into datums, returns the number of datums or -1 on error
+    long ReadBlock(size_t i, std::vector<uint16_t>& datums);
+    bool Error() const { return _error; }
+
+    /// Largest block, the 4 MB block size of the LZ4 frame
+    static const size_t kBlockSize = 4 << 20;
+
+ private:
+    struct Header;
+
+    FILE* _file{nullptr};
+    std::vector<AqsArchiveBlock> _blocks;
+    std::vector<AqsEventRecord> _events;
+    int _lastEvent{-1};
+    std::vector<char> _in;
+    bool _error{false};
+};
+
+#endif //DAQ_READER_SRC_AQSARCHIVE_HXX_
@@ -0,0 +1,123 @@
+#include "AqsIndex.hxx"
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Number of bytes at the beginning of the data file covered by the hash
+static const size_t kHashedHead = 64 * 1024;
+static const char kMagic[8] = {'A', 'Q', 'S', 'I', 'D', 'X', '0', '1'};
+
+struct AqsIndex::Header {
+    char magic[8];
+    uint32_t record_size;
+    int32_t last_event;
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t head_hash;
+    uint64_t n_events;
+};
+
+//******************************************************************************
+uint64_t AqsIndex::HeadHash(const std::string& data_file) {
+//******************************************************************************
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    FILE* f = fopen(data_file.c_str(), "rb");
+    if (!f)
+        return 0;
+    std::vector<unsigned char> head(kHashedHead);
+    auto n = fread(head.data(), 1, head.size(), f);
+    fclose(f);
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= head[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//******************************************************************************
+AqsIndex::Status AqsIndex::Load(const std::string& data_file,
+                                std::vector<AqsEventRecord>& events,
+                                int& last_event) {
+//******************************************************************************
+    struct stat st{};
+    if (stat(data_file.c_str(), &st) != 0)
+        return kMissing;
+
+    FILE* f = fopen(GetName(data_file).c_str(), "rb");
+    if (!f)
+        return kMissing;
+
+    Header header{};
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.record_size != sizeof(AqsEventRecord) ||
+        header.file_size > (uint64_t)st.st_size ||
+        header.head_hash != HeadHash(data_file)) {
+        fclose(f);
+        return kMissing;
+    }
+
+    events.resize(header.n_events);
+    if (header.n_events > 0 &&
+        fread(events.data(), sizeof(AqsEventRecord), header.n_events, f) != header.n_events) {
+        events.clear();
+        fclose(f);
+        return kMissing;
+    }
+    fclose(f);
+    last_event = header.last_event;
+
+    if (header.file_size == (uint64_t)st.st_size &&
+        header.mtime_sec == (int64_t)st.st_mtim.tv_sec &&
+        header.mtime_nsec == (int64_t)st.st_mtim.tv_nsec)
+        return kComplete;
+
+    // only an index of a file that has grown can be extended
+    if (header.file_size == (uint64_t)st.st_size || events.empty()) {
+        events.clear();
+        return kMissing;
+    }
+    return kGrown;
+}
+
+//******************************************************************************
+bool AqsIndex::Save(const std::string& data_file,
+                    uint64_t scanned_size,
+                    const std::vector<AqsEventRecord>& events,
+                    int last_event) {
+//******************************************************************************
+    struct stat st{};
+    if (stat(data_file.c_str(), &st) != 0)
+        return false;
+
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.record_size = sizeof(AqsEventRecord);
+    header.last_event = last_event;
+    header.file_size = scanned_size;
+    header.mtime_sec = st.st_mtim.tv_sec;
+    header.mtime_nsec = st.st_mtim.tv_nsec;
+    header.head_hash = HeadHash(data_file);
+    header.n_events = events.size();
+
+    // write a temporary file and move it in place so readers never see a partial index,
+    // the name is unique as several processes may index the same file at once
+    auto name = GetName(data_file);
+    auto tmp_name = name + ".tmp" + std::to_string(getpid());
+    FILE* f = fopen(tmp_name.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (ok && !events.empty())
+        ok = fwrite(events.data(), sizeof(AqsEventRecord), events.size(), f) == events.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), name.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
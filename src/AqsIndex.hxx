@@ -0,0 +1,54 @@
+#ifndef DAQ_READER_SRC_AQSINDEX_HXX_
+#define DAQ_READER_SRC_AQSINDEX_HXX_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Position and summary of one event in an AQS file
+struct AqsEventRecord {
+    /// byte offset of the start of event in the file
+    int64_t offset;
+    /// event number from the start of event
+    int32_t number;
+    /// bytes up to the next event (up to the end of the scanned data for the last one)
+    uint32_t size;
+    uint16_t time_lsb;
+    uint16_t time_mid;
+    uint16_t time_msb;
+    uint16_t reserved;
+};
+
+/// Sidecar event index of an AQS file stored next to it as <file>.idx
+/// The index is valid as long as the file size, modification time and the
+/// hash of the head of the file are unchanged. If only the head is the same and
+/// the file is longer, the index is a valid prefix that can be extended.
+class AqsIndex {
+ public:
+    enum Status {
+        kMissing,  ///< no usable index, the file has to be scanned
+        kComplete, ///< index covers the whole file
+        kGrown     ///< index covers the beginning of a file that has grown since
+    };
+
+    /// Read the index of the data file
+    //! \param events filled with the event records
+    //! \param last_event the last event number seen during the scan
+    static Status Load(const std::string& data_file,
+                       std::vector<AqsEventRecord>& events,
+                       int& last_event);
+    /// Store the index of the first scanned_size bytes of the data file
+    static bool Save(const std::string& data_file,
+                     uint64_t scanned_size,
+                     const std::vector<AqsEventRecord>& events,
+                     int last_event);
+
+    static std::string GetName(const std::string& data_file) { return data_file + ".idx"; }
+
+ private:
+    struct Header;
+    /// FNV-1a hash of the first bytes of the file
+    static uint64_t HeadHash(const std::string& data_file);
+};
+
+#endif //DAQ_READER_SRC_AQSINDEX_HXX_
@@ -0,0 +1,77 @@
+#include "CompactEvent.hxx"
+#include "HitPool.hxx"
+
+//******************************************************************************
+void CompactEvent::Reset(long int id) {
+//******************************************************************************
+    _id = id;
+    _timeMid = _timeMsb = _timeLsb = 0;
+    _card.clear();
+    _chip.clear();
+    _channel.clear();
+    _time.clear();
+    _length.clear();
+    _offset.clear();
+    _samples.clear();
+}
+
+//******************************************************************************
+void CompactEvent::SetTime(uint16_t mid, uint16_t msb, uint16_t lsb) {
+//******************************************************************************
+    _timeMid = mid;
+    _timeMsb = msb;
+    _timeLsb = lsb;
+}
+
+//******************************************************************************
+void CompactEvent::Reserve(size_t hits, size_t samples) {
+//******************************************************************************
+    _card.reserve(hits);
+    _chip.reserve(hits);
+    _channel.reserve(hits);
+    _time.reserve(hits);
+    _length.reserve(hits);
+    _offset.reserve(hits);
+    _samples.reserve(samples);
+}
+
+//******************************************************************************
+uint16_t* CompactEvent::AddHit(int card, int chip, int channel, int time, size_t n) {
+//******************************************************************************
+    _card.push_back(card);
+    _chip.push_back(chip);
+    _channel.push_back(channel);
+    _time.push_back(time);
+    _length.push_back(n);
+    _offset.push_back(_samples.size());
+    _samples.resize(_samples.size() + n);
+    return _samples.data() + _offset.back();
+}
+
+//******************************************************************************
+void CompactEvent::Assign(const TRawEvent& event) {
+//******************************************************************************
+    Reset(event.GetID());
+    SetTime(event.GetTimeMid(), event.GetTimeMsb(), event.GetTimeLsb());
+    const auto& hits = event.GetHits();
+    Reserve(hits.size());
+    for (const auto& hit : hits) {
+        const auto& adc = hit->GetADCvector();
+        AddHit(hit->GetCard(), hit->GetChip(), hit->GetChannel(), hit->GetTime(), adc, adc.size());
+    }
+}
+
+//******************************************************************************
+TRawEvent* CompactEvent::ToRawEvent() const {
+//******************************************************************************
+    auto event = new TRawEvent(_id);
+    event->SetTime(_timeMid, _timeMsb, _timeLsb);
+    event->Reserve(GetNHits());
+    for (size_t i = 0; i < GetNHits(); ++i) {
+        auto hit = new TRawHit(_card[i], _chip[i], _channel[i]);
+        hit->ResetWF();
+        SetWaveformSpan(hit, _time[i], GetSamples(i), _length[i]);
+        event->AddHit(hit);
+    }
+    return event;
+}
@@ -0,0 +1,75 @@
+#ifndef DAQ_READER_SRC_COMPACTEVENT_HXX_
+#define DAQ_READER_SRC_COMPACTEVENT_HXX_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TRawEvent.hxx"
+
+/// Event held as structure of arrays with 16-bit fields.
+/// Every hit has its card, chip, channel, first time bin and number of samples, the 12-bit
+/// samples of all the hits follow each other in one pool. Nothing is allocated per hit and
+/// the buffers keep their capacity when the event is reset, so a reused event stays in cache.
+/// Converted to and from TRawEvent for the code working with the hat_event classes
+class CompactEvent {
+ public:
+    CompactEvent() = default;
+    explicit CompactEvent(long int id) : _id(id) {}
+
+    /// Remove the hits and start the event id, the memory is kept
+    void Reset(long int id);
+    void SetTime(uint16_t mid, uint16_t msb, uint16_t lsb);
+    /// Make room for the hits and their samples
+    void Reserve(size_t hits, size_t samples = 0);
+
+    //! Append a hit of n samples starting at the time bin time
+    //! \return the samples of the hit, zeros to be written, valid until the next AddHit
+    uint16_t* AddHit(int card, int chip, int channel, int time, size_t n);
+    /// Append a hit with the samples copied from adc, a pointer or any other type indexed by the sample number
+    template<typename T>
+    void AddHit(int card, int chip, int channel, int time, const T& adc, size_t n) {
+        auto samples = AddHit(card, chip, channel, time, n);
+        for (size_t k = 0; k < n; ++k)
+            samples[k] = adc[k];
+    }
+
+    long int GetID() const { return _id; }
+    uint16_t GetTimeMid() const { return _timeMid; }
+    uint16_t GetTimeMsb() const { return _timeMsb; }
+    uint16_t GetTimeLsb() const { return _timeLsb; }
+
+    size_t GetNHits() const { return _card.size(); }
+    uint16_t GetCard(size_t i) const { return _card[i]; }
+    uint16_t GetChip(size_t i) const { return _chip[i]; }
+    uint16_t GetChannel(size_t i) const { return _channel[i]; }
+    /// First time bin of the hit
+    uint16_t GetTime(size_t i) const { return _time[i]; }
+    /// Number of samples of the hit
+    uint16_t GetLength(size_t i) const { return _length[i]; }
+    const uint16_t* GetSamples(size_t i) const { return _samples.data() + _offset[i]; }
+    /// Samples of all the hits
+    const std::vector<uint16_t>& GetSamplePool() const { return _samples; }
+
+    /// Replace the content with the one of the TRawEvent
+    void Assign(const TRawEvent& event);
+    /// New TRawEvent with its own hits, owned by the caller
+    TRawEvent* ToRawEvent() const;
+
+ private:
+    long int _id{0};
+    uint16_t _timeMid{0};
+    uint16_t _timeMsb{0};
+    uint16_t _timeLsb{0};
+
+    std::vector<uint16_t> _card;
+    std::vector<uint16_t> _chip;
+    std::vector<uint16_t> _channel;
+    std::vector<uint16_t> _time;
+    std::vector<uint16_t> _length;
+    /// first sample of each hit in _samples
+    std::vector<uint32_t> _offset;
+    std::vector<uint16_t> _samples;
+};
+
+#endif //DAQ_READER_SRC_COMPACTEVENT_HXX_
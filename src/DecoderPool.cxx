@@ -0,0 +1,106 @@
+#include "DecoderPool.hxx"
+#include "InterfaceFactory.hxx"
+
+#include <algorithm>
+
+/// Consecutive events decoded by one thread, keeps the reading of each interface forward
+static const uint64_t kBatch = 64;
+
+//******************************************************************************
+DecoderPool::DecoderPool(const InterfaceBase& scanned, const std::string& file_name, int n_threads,
+                         const ReadAheadOptions& io, const RootReadOptions& root) {
+//******************************************************************************
+    for (int i = 0; i < n_threads; ++i) {
+        auto interface = InterfaceFactory::get(file_name);
+        if (interface) {
+            interface->SetReadAhead(io);
+            interface->SetRootOptions(root);
+        }
+        // the messages were already printed by the scanned interface
+        if (!interface || !interface->Initialise(file_name, -1)) {
+            std::cerr << "Interface initialisation fails. Exit" << std::endl;
+            exit(1);
+        }
+        interface->CopyScan(scanned);
+        _interfaces.push_back(interface);
+    }
+}
+
+//******************************************************************************
+DecoderPool::~DecoderPool() {
+//******************************************************************************
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _space.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+    for (auto& event : _events)
+        delete event.second;
+}
+
+//******************************************************************************
+void DecoderPool::Start(uint64_t n_events, const std::vector<uint64_t>& batches) {
+//******************************************************************************
+    _nEvents = n_events;
+    for (auto first : batches)
+        if (first < n_events && (_batches.empty() || first > _batches.back()))
+            _batches.push_back(first);
+    if (_batches.empty() || _batches.front() != 0)
+        _batches.insert(_batches.begin(), 0);
+    if (batches.empty())
+        for (uint64_t first = kBatch; first < n_events; first += kBatch)
+            _batches.push_back(first);
+    _batches.push_back(n_events);
+
+    // the decoding may run ahead by a few batches per thread
+    uint64_t largest = 0;
+    for (size_t i = 0; i + 1 < _batches.size(); ++i)
+        largest = std::max(largest, _batches[i + 1] - _batches[i]);
+    _window = std::max(4 * kBatch, 2 * largest) * _interfaces.size();
+    for (auto& interface : _interfaces)
+        _workers.emplace_back(&DecoderPool::Work, this, interface.get());
+}
+
+//******************************************************************************
+void DecoderPool::Work(InterfaceBase* interface) {
+//******************************************************************************
+    std::vector<TRawEvent*> events;
+    while (true) {
+        uint64_t first, last;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _space.wait(lock, [this]() { return _stop || _batches[_nextBatch] < _nextOut + _window; });
+            if (_stop || _nextBatch + 1 >= _batches.size())
+                return;
+            first = _batches[_nextBatch];
+            last = _batches[++_nextBatch];
+        }
+        events.clear();
+        for (auto id = first; id < last; ++id)
+            events.push_back(interface->GetEvent(id));
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto id = first; id < last; ++id)
+                _events[id] = events[id - first];
+        }
+        _ready.notify_all();
+    }
+}
+
+//******************************************************************************
+TRawEvent* DecoderPool::Next() {
+//******************************************************************************
+    TRawEvent* event;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _ready.wait(lock, [this]() { return _events.count(_nextOut) > 0; });
+        auto it = _events.find(_nextOut);
+        event = it->second;
+        _events.erase(it);
+        ++_nextOut;
+    }
+    _space.notify_all();
+    return event;
+}
@@ -0,0 +1,53 @@
+#ifndef DAQ_READER_SRC_DECODERPOOL_HXX_
+#define DAQ_READER_SRC_DECODERPOOL_HXX_
+
+#include "InterfaceBase.hxx"
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Decode the events of one file with several threads.
+/// Every thread owns its own input interface, the events are handed out in the file order.
+class DecoderPool {
+ public:
+    //! \param scanned interface of the file already scanned, its events are copied to the ones of the threads
+    DecoderPool(const InterfaceBase& scanned, const std::string& file_name, int n_threads,
+                const ReadAheadOptions& io = {}, const RootReadOptions& root = {});
+    ~DecoderPool();
+
+    /// Start decoding the events [0, n_events)
+    //! \param batches first events of the batches taken by the threads, e.g. the clusters of
+    //! a ROOT tree, batches of kBatch events when empty
+    void Start(uint64_t n_events, const std::vector<uint64_t>& batches = {});
+    /// Get the next event in the file order, wait until it is decoded.
+    /// The ownership of the event is passed to the caller
+    TRawEvent* Next();
+
+ private:
+    void Work(InterfaceBase* interface);
+
+    std::vector<std::shared_ptr<InterfaceBase>> _interfaces;
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    /// signals the decoded events and the free space in the window
+    std::condition_variable _ready;
+    std::condition_variable _space;
+    /// decoded events waiting for the writer
+    std::map<uint64_t, TRawEvent*> _events;
+    uint64_t _nEvents{0};
+    /// first events of the batches followed by _nEvents, and the next batch to be decoded
+    std::vector<uint64_t> _batches;
+    size_t _nextBatch{0};
+    /// next event to be given to the writer
+    uint64_t _nextOut{0};
+    /// how far the decoding may run ahead of the writer
+    uint64_t _window{0};
+    bool _stop{false};
+};
+
+#endif //DAQ_READER_SRC_DECODERPOOL_HXX_
@@ -325,7 +325,7 @@ void EventDisplay::DoDraw() {
 
   // read event
   // WARNING due to some bug events MAY BE skipped qt the first read
-  _event = _interface->GetEvent(eventID);
+  _interface->GetEvent(eventID, _event);
 
   std::cout << "\rEvent\t" << eventID << " from " << Nevents;
   std::cout << " in the file (" << _nEvents_run << " in run in total)" << std::flush;
@@ -339,7 +339,7 @@ void EventDisplay::DoDraw() {
 
   std::unordered_map<int, int> charge;
 
-  for (const auto& hit : _event->GetHits()) {
+  for (const auto& hit : _event.GetHits()) {
     auto wf = hit->GetADCvector();
     auto max = std::max_element(wf.cbegin(), wf.cend());
     if (*max == 0)
@@ -549,7 +549,7 @@ void EventDisplay::DrawWF() {
   for (auto & i : WF) {
       i->Reset();
   }
-  for (const auto& hit : _event->GetHits()) {
+  for (const auto& hit : _event.GetHits()) {
     if (_x_clicked+1 > 35 || _x_clicked-1 < 0 || _y_clicked+1 > 31 || _y_clicked-1 < 0)
       continue;
 
@@ -57,7 +57,8 @@ private:
     DAQ _daq;
     Mapping _t2k;
 
-    TRawEvent* _event;
+    /// Displayed event, read again into the same event with the hits of the interface
+    PooledEvent _event;
 
     // WF plotter params
     TH2F* MM;
@@ -0,0 +1,57 @@
+#ifndef DAQ_READER_SRC_HITPOOL_HXX_
+#define DAQ_READER_SRC_HITPOOL_HXX_
+
+#include <memory>
+#include <vector>
+
+#include "TRawEvent.hxx"
+
+/// Set the n samples of the hit starting at the time bin time, adc is a pointer or any other
+/// type indexed by the sample number. TRawHit has no setter for a span, the samples are set one by one
+template<typename T>
+inline void SetWaveformSpan(TRawHit* hit, int time, const T& adc, size_t n) {
+    for (size_t k = 0; k < n; ++k)
+        hit->SetADCunit(time + k, adc[k]);
+}
+
+/// Hits recycled from one event to the next. The pool owns its hits, Get hands them out
+/// in turn and Recycle makes all of them available again, so once the pool has grown to
+/// the largest event no hit is allocated. The waveforms keep their capacity as well
+class HitPool {
+ public:
+    /// A hit of the channel, its waveform is to be reset by the caller
+    TRawHit* Get(int card, int chip, int channel) {
+        if (_used == _hits.size())
+            _hits.emplace_back(new TRawHit(card, chip, channel));
+        auto hit = _hits[_used++].get();
+        hit->SetCard(card);
+        hit->SetChip(chip);
+        hit->SetChannel(channel);
+        return hit;
+    }
+    /// The hits handed out so far are free again, they should not be used anymore
+    void Recycle() { _used = 0; }
+    size_t GetCapacity() const { return _hits.size(); }
+
+ private:
+    std::vector<std::unique_ptr<TRawHit>> _hits;
+    size_t _used{0};
+};
+
+/// Event holding the hits of a HitPool. They belong to the pool, so they are detached
+/// instead of being deleted with the event.
+/// TRawEvent has no call releasing its hits, Release takes them out of fHits so that the
+/// TRawEvent destructor, which deletes the hits left in fHits, never sees them
+class PooledEvent : public TRawEvent {
+ public:
+    PooledEvent() = default;
+    explicit PooledEvent(long int id) : TRawEvent(id) {}
+    PooledEvent(const PooledEvent&) = delete;
+    PooledEvent& operator=(const PooledEvent&) = delete;
+    ~PooledEvent() { Release(); }
+
+    /// Detach the hits without deleting them, the event is left without hits
+    void Release() { fHits.clear(); }
+};
+
+#endif //DAQ_READER_SRC_HITPOOL_HXX_
@@ -4,26 +4,400 @@
 
 #include "InterfaceAqs.hxx"
 
-#include <unordered_map>
+#include <algorithm>
+#include <thread>
+
+#include "frame.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Number of datums read at once when the file can not be mapped
+static const size_t kReadChunk = 1 << 16;
+/// Smallest part of the file given to a scan thread, in bytes
+static const size_t kMinScanChunk = 64 << 20;
+/// Blocks decompressed in advance for the compressed and piped inputs
+static const int kStreamDepth = 4;
+
+static bool HasSuffix(const std::string& name, const std::string& suffix) {
+    return name.size() >= suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+InterfaceAQS::~InterfaceAQS() {
+    UnmapFile();
+    if (_fd >= 0)
+        close(_fd);
+    if (_fsrc)
+        fclose(_fsrc);
+}
 
 //******************************************************************************
 bool InterfaceAQS::Initialise(const std::string& file_namme, int verbose) {
 //******************************************************************************
     _verbose = verbose;
-    std::cout << "Initialise AQS interface" << std::endl;
-    _fsrc = fopen(file_namme.c_str(), "rb");
+    if (_verbose >= 0)
+        std::cout << "Initialise AQS interface" << std::endl;
+    _fileName = file_namme;
     _daq.loadDAQ();
-    cout << "...DAQ loaded successfully" << endl;
+    if (_verbose >= 0)
+        cout << "...DAQ loaded successfully" << endl;
 
     _t2k.loadMapping();
-    cout << "...Mapping loaded succesfully." << endl;
+    if (_verbose >= 0)
+        cout << "...Mapping loaded succesfully." << endl;
     _firstEv = -1;
+    // room for two cards, grows on demand
+    GrowSlots(HashChannel(2, 0, 0) - 1);
+
+    if (HasSuffix(file_namme, ".aqs.lz4")) {
+        _archive.reset(new AqsArchive());
+        if (_archive->Open(file_namme)) {
+            if (_verbose > 0)
+                std::cout << "...Archive of " << _archive->GetNBlocks() << " blocks" << std::endl;
+            _nextBlock = 0;
+            return true;
+        }
+        // an LZ4 file without the index of AqsPack is only decompressed
+        _archive.reset();
+        _stream = true;
+    }
+    if (file_namme == "-" || HasSuffix(file_namme, ".gz") || HasSuffix(file_namme, ".bz2"))
+        _stream = true;
 
+    if (_stream) {
+        // decompressed by the midasio readers on the thread of the read-ahead engine
+        auto io = _io;
+        io.depth = std::max(io.depth, kStreamDepth);
+        io.direct = false;
+        _ahead.reset(new ReadAhead(io));
+        bool ok = file_namme == "-" ? _ahead->Open(file_namme) : _ahead->Open(TMNewReader(file_namme.c_str()));
+        if (!ok) {
+            std::cerr << "Input file could not be read" << std::endl;
+            std::cerr << "File: " << file_namme << std::endl;
+            return false;
+        }
+        if (_verbose > 0)
+            std::cout << "...File read as a stream, the events only in the file order" << std::endl;
+        return true;
+    }
+
+    if (_io.depth > 0) {
+        // blocks are read in advance by the read-ahead engine instead of the mapping
+        _ahead.reset(new ReadAhead(_io));
+        if (!_ahead->Open(file_namme)) {
+            std::cerr << "Input file could not be read" << std::endl;
+            std::cerr << "File: " << file_namme << std::endl;
+            return false;
+        }
+        if (_verbose > 0)
+            std::cout << "...File read with " << _io.depth << " blocks in advance" << std::endl;
+        return true;
+    }
+
+    _fsrc = fopen(file_namme.c_str(), "rb");
     if (_fsrc == nullptr) {
         std::cerr << "Input file could not be read" << std::endl;
         std::cerr << "File: " << _fsrc << std::endl;
+        return true;
+    }
+
+    // Prefer reading through a memory mapping, fall back to buffered fread.
+    // The descriptor is shared with the stream, a pipe can not be opened twice
+    _fd = dup(fileno(_fsrc));
+    if (_fd >= 0 && MapFile()) {
+        if (_verbose > 0)
+            std::cout << "...File mapped into memory" << std::endl;
+    } else {
+        _buffer.resize(kReadChunk);
+    }
+
+    return true;
+}
+
+//******************************************************************************
+bool InterfaceAQS::MapFile() {
+//******************************************************************************
+    struct stat st{};
+    if (fstat(_fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return false;
+    if (_data && (size_t)st.st_size == _mapSize)
+        return true;
+
+    UnmapFile();
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    madvise(addr, st.st_size, MADV_WILLNEED);
+    _data = static_cast<const uint16_t*>(addr);
+    _mapSize = st.st_size;
+    return true;
+}
+
+//******************************************************************************
+void InterfaceAQS::UnmapFile() {
+//******************************************************************************
+    if (_data)
+        munmap(const_cast<uint16_t*>(_data), _mapSize);
+    _data = nullptr;
+    _mapSize = 0;
+}
+
+//******************************************************************************
+void InterfaceAQS::Seek(long int offset) {
+//******************************************************************************
+    _cursor = offset / sizeof(uint16_t);
+    if (_archive) {
+        // only the block owning the offset is decompressed, unless it is held already
+        auto i = _archive->FindBlock(offset);
+        if (i >= _archive->GetNBlocks() || (i != _bufferBlock && !LoadArchiveBlock(i))) {
+            _bufferHead = _bufferTail = 0;
+            return;
+        }
+        _bufferHead = (offset - _archive->GetBlock(i).data_offset) / sizeof(uint16_t);
+        _bufferTail = _archive->GetBlock(i).data_size / sizeof(uint16_t);
+        _nextBlock = i + 1;
+        return;
+    }
+    _bufferHead = _bufferTail = 0;
+    if (_ahead)
+        _ahead->Seek(offset);
+    else if (!_data)
+        fseek(_fsrc, offset, SEEK_SET);
+}
+
+//******************************************************************************
+size_t InterfaceAQS::NextBlock(const uint16_t*& block) {
+//******************************************************************************
+    size_t n;
+    if (_data) {
+        auto total = _mapSize / sizeof(uint16_t);
+        n = _cursor < total ? total - _cursor : 0;
+        block = _data + _cursor;
+    } else if (_ahead) {
+        const char* data;
+        n = _ahead->Next(data) / sizeof(uint16_t);
+        block = reinterpret_cast<const uint16_t*>(data);
+    } else {
+        if (_bufferHead == _bufferTail && _archive) {
+            if (_nextBlock < _archive->GetNBlocks() && LoadArchiveBlock(_nextBlock))
+                ++_nextBlock;
+        } else if (_bufferHead == _bufferTail) {
+            _bufferTail = fread(_buffer.data(), sizeof(uint16_t), _buffer.size(), _fsrc);
+            _bufferHead = 0;
+        }
+        n = _bufferTail - _bufferHead;
+        block = _buffer.data() + _bufferHead;
+        _bufferHead = _bufferTail;
+    }
+    _cursor += n;
+    return n;
+}
+
+//******************************************************************************
+bool InterfaceAQS::LoadArchiveBlock(size_t i) {
+//******************************************************************************
+    auto n = _archive->ReadBlock(i, _buffer);
+    _bufferHead = 0;
+    _bufferTail = n > 0 ? n : 0;
+    _bufferBlock = n >= 0 ? i : SIZE_MAX;
+    if (n < 0)
+        std::cerr << "Archive block " << i << " could not be decompressed" << std::endl;
+    return n >= 0;
+}
+
+//******************************************************************************
+void InterfaceAQS::Unread(size_t n) {
+//******************************************************************************
+    _cursor -= n;
+    if (_ahead)
+        _ahead->Unread(n * sizeof(uint16_t));
+    else if (!_data)
+        _bufferHead -= n;
+}
+
+//******************************************************************************
+bool InterfaceAQS::ReadError() const {
+//******************************************************************************
+    if (_ahead)
+        return _ahead->Error();
+    if (_archive)
+        return _archive->Error();
+    return !_data && _fsrc && ferror(_fsrc);
+}
+
+/// Items that may be found in the file, anything else is treated as corruption
+static const unsigned int kKnownItems = IT_ADC_SAMPLE | IT_DATA_FRAME | IT_END_OF_FRAME | IT_MONITORING_FRAME |
+                                        IT_CONFIGURATION_FRAME | IT_SHORT_MESSAGE | IT_LONG_MESSAGE |
+                                        IT_TIME_BIN_INDEX | IT_CHANNEL_HIT_HEADER | IT_NULL_DATUM |
+                                        IT_CHANNEL_HIT_COUNT | IT_LAST_CELL_READ | IT_END_OF_EVENT |
+                                        IT_PED_HISTO_MD | IT_UNKNOWN | IT_CHAN_PED_CORRECTION |
+                                        IT_CHAN_ZERO_SUPPRESS_THRESHOLD;
+
+/// State of the file scan shared with the decoder sink
+struct InterfaceAQS::ScanState {
+    InterfaceAQS* self;
+    /// index of the first datum of the current block in the file
+    size_t blockStart;
+    int prevEvnum;
+};
+
+/// State of the event reading shared with the decoder sink
+struct InterfaceAQS::EventState {
+    InterfaceAQS* self;
+    long int id;
+    /// number of the event to be read, kAnyEvent takes the first one found
+    int expected;
+    int eventNumber;
+    bool done;
+    /// time stamp of the last start of event, given to the event when it is read
+    bool timed{false};
+    unsigned short timeMid{0};
+    unsigned short timeMsb{0};
+    unsigned short timeLsb{0};
+};
+
+static const int kAnyEvent = -2;
+
+
+/// Index entry for the start of event found at the byte offset pos
+static AqsEventRecord MakeEventRecord(long int pos, const DatumContext* dc) {
+    AqsEventRecord record{};
+    record.offset = pos;
+    record.number = (int32_t)dc->EventNumber;
+    record.time_lsb = dc->EventTimeStampLsb;
+    record.time_mid = dc->EventTimeStampMid;
+    record.time_msb = dc->EventTimeStampMsb;
+    return record;
+}
+
+/// Result of the scan of one chunk of the file by a worker thread.
+/// Workers except the first one start in the middle of the data and may decode garbage
+/// until they meet the first start of event prefix, their results are confirmed while stitching.
+struct InterfaceAQS::ChunkScan {
+    /// index of the first datum of the chunk in the file
+    size_t blockStart;
+    /// starts of events in the file order
+    std::vector<AqsEventRecord> events;
+    /// byte offsets of the decoding errors and unexpected items
+    std::vector<int64_t> faults;
+    /// decoder state at the end of the chunk
+    DatumContext dc;
+    /// used while stitching: the chunk which results are expected to be found
+    const ChunkScan* next;
+    /// used while stitching: byte offset where the decoding met the results of next
+    int64_t syncOffset;
+};
+
+//******************************************************************************
+int InterfaceAQS::ChunkSink(void* user, const DatumContext* dc, const DatumItem* item) {
+//******************************************************************************
+    // collect the starts of events and the faults, never stop
+    auto chunk = static_cast<ChunkScan*>(user);
+    auto pos = (int64_t)(chunk->blockStart + item->Position) * sizeof(uint16_t);
+    if (item->Error < 0 || !(item->ItemType & kKnownItems))
+        chunk->faults.push_back(pos);
+    else if (item->ItemType == IT_START_OF_EVENT)
+        chunk->events.push_back(MakeEventRecord(pos - 5 * sizeof(uint16_t), dc));
+    return 0;
+}
+
+//******************************************************************************
+int InterfaceAQS::StitchSink(void* user, const DatumContext* dc, const DatumItem* item) {
+//******************************************************************************
+    // decode from a known state until a start of event already found by the next chunk,
+    // both decoders were in the prefix mode at this datum so they agree from here on
+    auto chunk = static_cast<ChunkScan*>(user);
+    auto pos = (int64_t)(chunk->blockStart + item->Position) * sizeof(uint16_t);
+    if (item->Error < 0 || !(item->ItemType & kKnownItems)) {
+        chunk->faults.push_back(pos);
+        return 1;
     }
+    if (item->ItemType == IT_START_OF_EVENT) {
+        auto record = MakeEventRecord(pos - 5 * sizeof(uint16_t), dc);
+        const auto& next = chunk->next->events;
+        auto found = std::lower_bound(next.begin(), next.end(), record,
+                                      [](const AqsEventRecord& a, const AqsEventRecord& b) {
+                                          return a.offset < b.offset;
+                                      });
+        if (found != next.end() && found->offset == record.offset) {
+            chunk->syncOffset = record.offset;
+            return 1;
+        }
+        chunk->events.push_back(record);
+    }
+    return 0;
+}
+
+//******************************************************************************
+bool InterfaceAQS::ScanParallel(size_t begin, std::vector<AqsEventRecord>& events) {
+//******************************************************************************
+    size_t end = _mapSize / sizeof(uint16_t);
+    if (!_data || begin >= end)
+        return false;
+    size_t nThreads = std::thread::hardware_concurrency();
+    nThreads = std::min(nThreads, (end - begin) * sizeof(uint16_t) / kMinScanChunk);
+    if (nThreads < 2)
+        return false;
+
+    // chunk k covers the datums [bounds[k], bounds[k+1])
+    std::vector<size_t> bounds(nThreads + 1);
+    for (size_t k = 0; k <= nThreads; ++k)
+        bounds[k] = begin + (end - begin) * k / nThreads;
 
+    std::vector<ChunkScan> chunks(nThreads);
+    std::vector<std::thread> workers;
+    for (size_t k = 0; k < nThreads; ++k) {
+        auto& chunk = chunks[k];
+        chunk.blockStart = bounds[k];
+        chunk.dc = _dc;
+        if (k > 0)
+            DatumContext_Init(&chunk.dc, _sample_index_offset_zs);
+        workers.emplace_back([this, &chunk, &bounds, k]() {
+            Datum_ScanBlock(&chunk.dc, _data + bounds[k], bounds[k + 1] - bounds[k], ChunkSink, &chunk);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    // the first chunk starts from a known state, the following ones are confirmed one by one
+    // by continuing the decoding of the previous chunk across the boundary
+    if (!chunks[0].faults.empty())
+        return false;
+    events = std::move(chunks[0].events);
+    DatumContext dc = chunks[0].dc;
+    for (size_t k = 1; k < nThreads; ++k) {
+        ChunkScan stitch;
+        stitch.blockStart = bounds[k];
+        stitch.next = &chunks[k];
+        stitch.syncOffset = -1;
+        stitch.dc = dc;
+        Datum_ScanBlock(&stitch.dc, _data + bounds[k], bounds[k + 1] - bounds[k], StitchSink, &stitch);
+        // faults are reported by the serial scan
+        if (!stitch.faults.empty())
+            return false;
+        events.insert(events.end(), stitch.events.begin(), stitch.events.end());
+        if (stitch.syncOffset < 0) {
+            // no common start of event in the chunk, it was decoded by the stitching itself
+            dc = stitch.dc;
+            continue;
+        }
+        const auto& chunk = chunks[k];
+        if (!chunk.faults.empty() && chunk.faults.back() >= stitch.syncOffset)
+            return false;
+        for (const auto& record : chunk.events)
+            if (record.offset >= stitch.syncOffset)
+                events.push_back(record);
+        dc = chunk.dc;
+    }
+    // datum counters of the workers are not meaningful, the state is kept for the following reads
+    _dc = dc;
+    _cursor = end;
+    if (_verbose > 0)
+        std::cout << "File scanned in " << nThreads << " chunks" << std::endl;
     return true;
 }
 
@@ -33,185 +407,384 @@ uint64_t InterfaceAQS::Scan(int start, bool refresh, int& Nevents_run) {
     // Reset _eventPos vector
     // Scan the file
     DatumContext_Init(&_dc, _sample_index_offset_zs);
-    unsigned short datum;
-    int err;
-    bool done = true;
-    int prevEvnum = -1;
-    int evnum;
-    if (_verbose > 0 || refresh)
-        std::cout << "\nScanning the file..." << std::endl;
+    const uint16_t* block;
+    size_t nDatum;
+    // pick up the data appended since the previous scan
+    if (_data)
+        MapFile();
+    if (_stream) {
+        std::cerr << "Compressed and piped inputs could not be scanned, they are read with NextEvent" << std::endl;
+        Nevents_run = -1;
+        return 0;
+    }
+    if (_archive) {
+        // the archive carries the index of the whole file
+        _eventPos = _archive->GetEvents();
+        _firstEv = _eventPos.empty() ? -1 : _eventPos.front().number;
+        cout << _eventPos.size() << " events in the archive." << std::endl;
+        Nevents_run = _archive->GetLastEvent();
+        return _eventPos.size();
+    }
     if (refresh) {
         _eventPos.clear();
-        fseek(_fsrc, 0, SEEK_SET);
+        _firstEv = -1;
         lastRead = 0;
+        int last_event = -1;
+        auto status = AqsIndex::Load(_fileName, _eventPos, last_event);
+        if (status != AqsIndex::kMissing && !_eventPos.empty()) {
+            _firstEv = _eventPos.front().number;
+            lastRead = _eventPos.back().offset;
+        }
+        if (status == AqsIndex::kComplete) {
+            if (_verbose > 0)
+                std::cout << "Event index read from " << AqsIndex::GetName(_fileName) << std::endl;
+            cout << _eventPos.size() << " events in the file." << std::endl;
+            Nevents_run = last_event;
+            return _eventPos.size();
+        }
+        if (status == AqsIndex::kGrown) {
+            // the file was extended after the index was written, scan only the new part
+            if (_verbose > 0)
+                std::cout << "Extending the event index " << AqsIndex::GetName(_fileName) << std::endl;
+            refresh = false;
+            start = (int)_eventPos.size() - 1;
+        }
+    }
+    if (_verbose > 0 || refresh)
+        std::cout << "\nScanning the file..." << std::endl;
+    if (refresh) {
+        Seek(0);
     }
     else {
-        fseek(_fsrc, _eventPos[start].first, SEEK_SET);
+        Seek(_eventPos[start].offset);
     }
+    auto firstUpdated = refresh ? 0 : start;
+    auto nBefore = _eventPos.size();
 
     _fea.TotalFileByteRead = lastRead;
-    while (done) {
-        // Read one short word
-        if (fread(&datum, sizeof(unsigned short), 1, _fsrc) != 1) {
-            done = false;
-        }
-        else {
-            _fea.TotalFileByteRead += sizeof(unsigned short);
-            // Interpret datum
-            if ((err = Datum_Decode(&_dc, datum)) < 0) {
-                printf("%d Datum_Decode: %s\n", err, &_dc.ErrorString[0]);
-                done = true;
-            }
-            else {
-                if (_dc.isItemComplete) {
-                    if (_dc.ItemType == IT_START_OF_EVENT) {
-                        evnum = (int)_dc.EventNumber;
-                        if (_firstEv < 0) {
-                            if (_verbose > 1)
-                                std::cout << "First event id  " << evnum << "  at  " << _fea.TotalFileByteRead - 6*sizeof(unsigned short) << std::endl;
-                            _eventPos.emplace_back(_fea.TotalFileByteRead - 6*sizeof(unsigned short), evnum);
-                            _firstEv = evnum;
-                            prevEvnum = evnum;
-                            lastRead = _fea.TotalFileByteRead - 6*sizeof(unsigned short);
-                        }
-                        else if (evnum != prevEvnum) {
-                            if (_fea.TotalFileByteRead - 6*sizeof(unsigned short) != _eventPos[_eventPos.size()-1].first) {
-                                _eventPos.emplace_back(_fea.TotalFileByteRead - 6*sizeof(unsigned short), evnum);
-                                if (_verbose > 1) {
-                                    std::cout << "Event " << evnum << " at " << _fea.TotalFileByteRead - 6 * sizeof(unsigned short)
-                                              << std::endl;
-                                    std::cout << "time lsb:msb:mid : " << _dc.EventTimeStampLsb << " " << _dc.EventTimeStampMsb << " "
-                                              << _dc.EventTimeStampMid << std::endl;
-                                }
-                                prevEvnum = evnum;
-                                lastRead = _fea.TotalFileByteRead - 6*sizeof(unsigned short);
-                            }
-                            else {
-                                prevEvnum = evnum;
-                            }
-                        }
-                    }
-                    else if (_dc.ItemType == IT_ADC_SAMPLE) {}
-                    else if (_dc.ItemType == IT_DATA_FRAME) {}
-                    else if (_dc.ItemType == IT_END_OF_FRAME) {}
-                    else if (_dc.ItemType == IT_MONITORING_FRAME) {}
-                    else if (_dc.ItemType == IT_CONFIGURATION_FRAME) {}
-                    else if (_dc.ItemType == IT_SHORT_MESSAGE) {}
-                    else if (_dc.ItemType == IT_LONG_MESSAGE) {}
-                    else if (_dc.ItemType == IT_TIME_BIN_INDEX) {}
-                    else if (_dc.ItemType == IT_CHANNEL_HIT_HEADER) {}
-                    else if (_dc.ItemType == IT_DATA_FRAME) {}
-                    else if (_dc.ItemType == IT_NULL_DATUM) {}
-                    else if (_dc.ItemType == IT_CHANNEL_HIT_COUNT) {}
-                    else if (_dc.ItemType == IT_LAST_CELL_READ) {}
-                    else if (_dc.ItemType == IT_END_OF_EVENT) {}
-                    else if (_dc.ItemType == IT_PED_HISTO_MD) {}
-                    else if (_dc.ItemType == IT_UNKNOWN) {}
-                    else if (_dc.ItemType == IT_CHAN_PED_CORRECTION) {}
-                    else if (_dc.ItemType == IT_CHAN_ZERO_SUPPRESS_THRESHOLD) {}
-                    else
-                    {
-                        cerr << "Interface.cxx: Unknown Item Type : " << _dc.ItemType << endl;
-                        cerr << "Program will exit to prevent the storing of the corrupted data" << endl;
-                        exit(1);
-                    }
-                }
-            }
-        }
+    ScanState state{this, 0, -1};
+    std::vector<AqsEventRecord> found;
+    if (ScanParallel(_cursor, found)) {
+        for (const auto& record : found)
+            AddStartOfEvent(record, state.prevEvnum);
+        _fea.TotalFileByteRead = _cursor * sizeof(uint16_t);
+    }
+    while (true) {
+        state.blockStart = _cursor;
+        if ((nDatum = NextBlock(block)) == 0)
+            break;
+        // only the start of event offsets are needed, samples are skipped
+        Datum_ScanBlock(&_dc, block, nDatum, ScanSink, &state);
+        _fea.TotalFileByteRead = _cursor * sizeof(uint16_t);
     }
     if (refresh || _verbose > 0) {
         cout << "Scan done." << std::endl;
         cout << _eventPos.size() << " events in the file." << std::endl;
     }
 
-    Nevents_run = prevEvnum;
+    // event sizes are known once the next event or the end of data is reached
+    int64_t scannedSize = _cursor * sizeof(uint16_t);
+    for (size_t i = firstUpdated; i < _eventPos.size(); ++i) {
+        auto end = i + 1 < _eventPos.size() ? _eventPos[i + 1].offset : scannedSize;
+        _eventPos[i].size = (uint32_t)(end - _eventPos[i].offset);
+    }
+    // the index is written when the scan found new events or once the file stopped growing,
+    // so the rescans of a growing file don't rewrite it each time
+    bool stopped = scannedSize == _scannedSize && scannedSize != _indexedSize;
+    if (_eventPos.size() > nBefore || stopped) {
+        if (AqsIndex::Save(_fileName, scannedSize, _eventPos, state.prevEvnum))
+            _indexedSize = scannedSize;
+        else if (_verbose > 0)
+            std::cout << "Event index could not be written to " << AqsIndex::GetName(_fileName) << std::endl;
+    }
+    _scannedSize = scannedSize;
+
+    Nevents_run = state.prevEvnum;
     return _eventPos.size();
 }
 
 //******************************************************************************
-TRawEvent* InterfaceAQS::GetEvent(long int id) {
+void InterfaceAQS::CopyScan(const InterfaceBase& scanned) {
 //******************************************************************************
-    unsigned short datum;
-    int err;
-    bool done = true;
-    if (_verbose > 1)
-        std::cout << "\nGetting event #" << id << "  at pos  " << _eventPos[id].first << "  with id  " << _eventPos[id].second << std::endl;;
+    auto& aqs = dynamic_cast<const InterfaceAQS&>(scanned);
+    // the file is mapped as far as it was scanned
+    if (_data)
+        MapFile();
+    DatumContext_Init(&_dc, _sample_index_offset_zs);
+    _eventPos = aqs._eventPos;
+    _firstEv = aqs._firstEv;
+    lastRead = aqs.lastRead;
+}
 
-    fseek(_fsrc, _eventPos[id].first, SEEK_SET);
+//******************************************************************************
+int InterfaceAQS::ScanSink(void* user, const DatumContext* dc, const DatumItem* item) {
+//******************************************************************************
+    auto state = static_cast<ScanState*>(user);
+    auto self = state->self;
+    if (item->Error < 0) {
+        printf("%d Datum_Decode: %s\n", item->Error, &dc->ErrorString[0]);
+        return 0;
+    }
+
+    if (item->ItemType == IT_START_OF_EVENT) {
+        // start of event is completed by the last of its 6 datums
+        long int pos = (state->blockStart + item->Position - 5) * sizeof(uint16_t);
+        self->AddStartOfEvent(MakeEventRecord(pos, dc), state->prevEvnum);
+    }
+    else if (!(item->ItemType & kKnownItems)) {
+        cerr << "Interface.cxx: Unknown Item Type : " << item->ItemType << endl;
+        cerr << "Program will exit to prevent the storing of the corrupted data" << endl;
+        exit(1);
+    }
+    return 0;
+}
+
+//******************************************************************************
+void InterfaceAQS::AddStartOfEvent(const AqsEventRecord& record, int& prevEvnum) {
+//******************************************************************************
+    auto pos = record.offset;
+    int evnum = record.number;
+    if (_firstEv < 0) {
+        if (_verbose > 1)
+            std::cout << "First event id  " << evnum << "  at  " << pos << std::endl;
+        _eventPos.push_back(record);
+        _firstEv = evnum;
+        prevEvnum = evnum;
+        lastRead = pos;
+    }
+    else if (evnum != prevEvnum) {
+        if (pos != _eventPos[_eventPos.size()-1].offset) {
+            _eventPos.push_back(record);
+            if (_verbose > 1) {
+                std::cout << "Event " << evnum << " at " << pos << std::endl;
+                std::cout << "time lsb:msb:mid : " << record.time_lsb << " " << record.time_msb << " "
+                          << record.time_mid << std::endl;
+            }
+            lastRead = pos;
+        }
+        prevEvnum = evnum;
+    }
+}
 
-    // clean the padAmpl
+//******************************************************************************
+TRawEvent* InterfaceAQS::GetEvent(long int id) {
+//******************************************************************************
     auto event = new TRawEvent(id);
-    int eventNumber = -1;
-    std::unordered_map<int32_t, TRawHit*> hitMap;
+    ReadEvent(id, *event);
+    return event;
+}
+
+//******************************************************************************
+bool InterfaceAQS::ReadEvent(long int id, TRawEvent& event) {
+//******************************************************************************
+    return DecodeEvent(id, event);
+}
+
+//******************************************************************************
+bool InterfaceAQS::ReadEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+    return DecodeEvent(id, event);
+}
+
+//******************************************************************************
+template<typename Event>
+bool InterfaceAQS::DecodeEvent(long int id, Event& event) {
+//******************************************************************************
+    const uint16_t* block;
+    size_t nDatum;
+    if (_verbose > 1)
+        std::cout << "\nGetting event #" << id << "  at pos  " << _eventPos[id].offset << "  with id  " << _eventPos[id].number << std::endl;;
+
+    Seek(_eventPos[id].offset);
 
-    while (done) {
-        if (fread(&datum, sizeof(unsigned short), 1, _fsrc) != 1) {
-            done = false;
-            if (ferror(_fsrc))
+    ResetEvent(event, id);
+    EventState state{this, id, _eventPos[id].number, -1, false};
+    while (!state.done) {
+        if ((nDatum = NextBlock(block)) == 0) {
+            if (ReadError())
                 cout << "\nERROR" << endl;
-            if (feof(_fsrc))
+            else
                 cout << "\nreach EOF" << endl;
-        } else {
+            break;
+        }
+        _fea.TotalFileByteRead += nDatum * sizeof(uint16_t);
+        auto used = Datum_DecodeBlock(&_dc, block, nDatum, EventSink, &state);
+        // keep the position after the event, the next one is usually read right after
+        Unread(nDatum - used);
+    }
 
-            _fea.TotalFileByteRead += sizeof(unsigned short);
-            // Interpret datum
-            if ((err = Datum_Decode(&_dc, datum)) < 0) {
-                printf("%d Datum_Decode: %s\n", err, &_dc.ErrorString[0]);
-                done = true;
-            }
+    if (state.timed)
+        event.SetTime(state.timeMid, state.timeMsb, state.timeLsb);
+    CollectHits(event);
+    return state.eventNumber >= 0;
+}
 
-            // Decode
-            if (_dc.isItemComplete) {
-
-                if (_dc.ItemType == IT_START_OF_EVENT) {
-                    if (_verbose > 1)
-                        std::cout << "Found event with id " << (int)_dc.EventNumber << std::endl;
-                    event->SetTime(_dc.EventTimeStampMid,
-                                   _dc.EventTimeStampMsb,
-                                   _dc.EventTimeStampLsb);
-
-                    if ((int)_dc.EventNumber == _eventPos[id].second)
-                        eventNumber = (int)_dc.EventNumber;
-                } else if (eventNumber == _eventPos[id].second && _dc.ItemType == IT_ADC_SAMPLE) {
-                    if (_dc.ChannelIndex != 15 && _dc.ChannelIndex != 28 && _dc.ChannelIndex != 53 && _dc.ChannelIndex != 66 && _dc.ChannelIndex > 2 && _dc.ChannelIndex < 79) {
-
-                        if (_verbose > 1) {
-                            std::cout << "card\t" << _dc.CardIndex << "\t" << _dc.ChipIndex << "\t" << _dc.ChannelIndex << std::endl;
-                        }
-                        auto chHash = HashChannel(_dc.CardIndex, _dc.ChipIndex, _dc.ChannelIndex);
-                        auto hitIt = hitMap.find(chHash);
-
-
-                        int a = (int)_dc.AbsoluteSampleIndex;
-                        int b = (int)_dc.AdcSample;
-
-                        if (hitIt != hitMap.end()) {
-                            hitMap[chHash]->SetADCunit(a, b);
-                        } else {
-                            auto hitCandidate = new TRawHit(_dc.CardIndex,
-                                                            _dc.ChipIndex,
-                                                            _dc.ChannelIndex);
-                            hitCandidate->ResetWF();
-                            hitCandidate->SetADCunit(a, b);
-                            hitMap[chHash] = hitCandidate;
-                        }
-                    }
-                }
-                else if (_dc.ItemType == IT_END_OF_EVENT) {
-                    // go to the next event
-                    done = false;
-                }
+//******************************************************************************
+bool InterfaceAQS::NextEvent(TRawEvent*& event) {
+//******************************************************************************
+    auto next = new TRawEvent(_nextStream);
+    if (!ReadNextEvent(*next)) {
+        delete next;
+        return false;
+    }
+    event = next;
+    return true;
+}
 
-            } // end of if (_dc.isItemComplete)
-        } // end of second loop inside while
-    } // end of while(done) loop
+//******************************************************************************
+bool InterfaceAQS::ReadNextEvent(TRawEvent& event) {
+//******************************************************************************
+    return DecodeNextEvent(event);
+}
+
+//******************************************************************************
+bool InterfaceAQS::ReadNextEvent(CompactEvent& event) {
+//******************************************************************************
+    return DecodeNextEvent(event);
+}
 
-    event->Reserve(hitMap.size());
-    for (auto& hit : hitMap) {
-        hit.second->ShrinkWF();
-        event->AddHit(hit.second);
+//******************************************************************************
+template<typename Event>
+bool InterfaceAQS::DecodeNextEvent(Event& event) {
+//******************************************************************************
+    const uint16_t* block;
+    size_t nDatum;
+    ResetEvent(event, _nextStream);
+    EventState state{this, _nextStream, kAnyEvent, -1, false};
+    while (!state.done) {
+        if ((nDatum = NextBlock(block)) == 0)
+            break;
+        _fea.TotalFileByteRead += nDatum * sizeof(uint16_t);
+        auto used = Datum_DecodeBlock(&_dc, block, nDatum, EventSink, &state);
+        // the rest of the block belongs to the following events
+        Unread(nDatum - used);
     }
-    return event;
+    if (ReadError())
+        cout << "\nERROR" << endl;
+    if (state.expected == kAnyEvent) {
+        // no start of event before the end of the input
+        return false;
+    }
+    if (!state.done)
+        cout << "\nreach EOF" << endl;
+    if (state.timed)
+        event.SetTime(state.timeMid, state.timeMsb, state.timeLsb);
+    CollectHits(event);
+    _streamEvnum = state.expected;
+    ++_nextStream;
+    return true;
+}
+
+//******************************************************************************
+template<typename Event>
+void InterfaceAQS::CollectHits(Event& event) {
+//******************************************************************************
+    // hits are built in the order the channels first appear in the event,
+    // the slots are cleared for the next event
+    event.Reserve(_touched.size());
+    for (auto chHash : _touched) {
+        auto& slot = _slots[chHash];
+        auto wf = &_waveforms[chHash * kMaxTimeBins];
+        AddSlotHit(event, slot, wf);
+        std::fill(wf + slot.first, wf + slot.last + 1, 0);
+        slot.first = kMaxTimeBins;
+        slot.last = -1;
+    }
+    _touched.clear();
+    _runs.clear();
+}
+
+//******************************************************************************
+void InterfaceAQS::AddSlotHit(TRawEvent& event, const HitSlot& slot, const short* wf) {
+//******************************************************************************
+    // only the decoded samples are set, the bins between the runs of zero suppressed data stay unset
+    auto hit = NewHit(slot.card, slot.chip, slot.channel);
+    for (auto r = slot.firstRun; r >= 0; r = _runs[r].next)
+        SetWaveformSpan(hit, _runs[r].first, wf + _runs[r].first, _runs[r].n);
+    event.AddHit(hit);
+}
+
+//******************************************************************************
+void InterfaceAQS::AddSlotHit(CompactEvent& event, const HitSlot& slot, const short* wf) {
+//******************************************************************************
+    // a compact hit is one span of samples, the bins between the runs are zeros
+    event.AddHit(slot.card, slot.chip, slot.channel, slot.first, wf + slot.first, slot.last - slot.first + 1);
+}
+
+//******************************************************************************
+int InterfaceAQS::EventSink(void* user, const DatumContext* dc, const DatumItem* item) {
+//******************************************************************************
+    auto state = static_cast<EventState*>(user);
+    auto self = state->self;
+    if (item->Error < 0) {
+        printf("%d Datum_Decode: %s\n", item->Error, &dc->ErrorString[0]);
+        return 0;
+    }
+
+    if (item->ItemType == IT_START_OF_EVENT) {
+        if (state->expected == kAnyEvent) {
+            // the following frames of the previous event are skipped as by the scan
+            if ((int)dc->EventNumber == self->_streamEvnum)
+                return 0;
+            state->expected = (int)dc->EventNumber;
+        }
+        if (self->_verbose > 1)
+            std::cout << "Found event with id " << (int)dc->EventNumber << std::endl;
+        state->timed = true;
+        state->timeMid = dc->EventTimeStampMid;
+        state->timeMsb = dc->EventTimeStampMsb;
+        state->timeLsb = dc->EventTimeStampLsb;
+
+        if ((int)dc->EventNumber == state->expected)
+            state->eventNumber = (int)dc->EventNumber;
+    } else if (state->eventNumber == state->expected && item->ItemType == IT_ADC_SAMPLE) {
+        if (dc->ChannelIndex < kValidChannels.size() && kValidChannels[dc->ChannelIndex]) {
+
+            if (self->_verbose > 1) {
+                std::cout << "card\t" << dc->CardIndex << "\t" << dc->ChipIndex << "\t" << dc->ChannelIndex << std::endl;
+            }
+            auto chHash = HashChannel(dc->CardIndex, dc->ChipIndex, dc->ChannelIndex);
+            if (chHash >= (int32_t)self->_slots.size())
+                self->GrowSlots(std::max(chHash, HashChannel(dc->CardIndex + 1, 0, 0) - 1));
+            // the run of samples is copied to the waveform of the channel
+            int t = item->AbsoluteSampleIndex;
+            int n = std::min((int)item->SampleCount, kMaxTimeBins - t);
+            if (t >= 0 && n > 0) {
+                auto& slot = self->_slots[chHash];
+                auto run = (int32_t)self->_runs.size();
+                self->_runs.push_back({(short)t, (short)n, -1});
+                if (slot.first > slot.last) {
+                    slot.card = dc->CardIndex;
+                    slot.chip = dc->ChipIndex;
+                    slot.channel = dc->ChannelIndex;
+                    slot.firstRun = run;
+                    self->_touched.push_back(chHash);
+                } else {
+                    self->_runs[slot.lastRun].next = run;
+                }
+                slot.lastRun = run;
+                auto wf = &self->_waveforms[chHash * kMaxTimeBins + t];
+                for (int k = 0; k < n; ++k)
+                    wf[k] = GET_ADC_DATA(item->Samples[k]);
+                slot.first = std::min(slot.first, (short)t);
+                slot.last = std::max(slot.last, (short)(t + n - 1));
+            }
+        }
+    }
+    else if (item->ItemType == IT_END_OF_EVENT && state->expected != kAnyEvent) {
+        // go to the next event
+        state->done = true;
+        return 1;
+    }
+    return 0;
+}
+
+//******************************************************************************
+void InterfaceAQS::GrowSlots(int32_t chHash) {
+//******************************************************************************
+    HitSlot empty{0, 0, 0, kMaxTimeBins, -1, -1, -1};
+    _slots.resize(chHash + 1, empty);
+    _waveforms.resize(_slots.size() * kMaxTimeBins, 0);
 }
 
 int32_t InterfaceAQS::HashChannel(const int card, const int chip, const int channel) {
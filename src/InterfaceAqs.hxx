@@ -6,23 +6,49 @@
 #define DAQ_READER_SRC_INTERFACEAQS_HXX_
 
 #include "InterfaceBase.hxx"
+#include "AqsIndex.hxx"
+#include "AqsArchive.hxx"
 
-/// AQS file reader
+#include <cstdint>
+#include <memory>
+
+/// AQS file reader, the .aqs.lz4 archives are read by decompressing the block of the event.
+/// The .aqs.gz, .aqs.bz2, plain .aqs.lz4 files and the standard input "-" are read
+/// as a stream with NextEvent, decompressed by the midasio readers in their own thread
 class InterfaceAQS : public InterfaceBase {
  public:
     explicit InterfaceAQS() = default;;
-    ~InterfaceAQS() override = default;
+    ~InterfaceAQS() override;
     bool Initialise(const std::string &file_name, int verbose) override;
     uint64_t Scan(int start, bool refresh, int &Nevents_run) override;
+    void CopyScan(const InterfaceBase &scanned) override;
+    using InterfaceBase::GetEvent;
+    using InterfaceBase::NextEvent;
     TRawEvent *GetEvent(long int id) override;
+    bool NextEvent(TRawEvent *&event) override;
     void GetTrackerEvent(long int id, Float_t pos[8]) override {
         throw std::logic_error("No tracker info in AQS");
     }
+    /// Events found by Scan
+    const std::vector<AqsEventRecord>& GetEventRecords() const { return _eventPos; }
+    /// The input could only be read once in the file order, Scan and GetEvent are not available
+    bool IsStream() const { return _stream; }
+
+ protected:
+    bool ReadEvent(long int id, TRawEvent &event) override;
+    bool ReadNextEvent(TRawEvent &event) override;
+    /// The samples go from the waveforms of the channels to the compact event without a TRawHit
+    bool ReadEvent(long int id, CompactEvent &event) override;
+    bool ReadNextEvent(CompactEvent &event) override;
 
  private:
     Features _fea;
-    std::vector<std::pair<long int, int> > _eventPos;
+    std::string _fileName;
+    std::vector<AqsEventRecord> _eventPos;
     __int64 lastRead;
+    /// Bytes of the file covered by the previous scan and by the index written last
+    int64_t _scannedSize{-1};
+    int64_t _indexedSize{-1};
     DatumContext _dc;
     FILE* _fsrc{nullptr};
     int _sample_index_offset_zs;
@@ -30,6 +56,89 @@ class InterfaceAQS : public InterfaceBase {
     Mapping _t2k;
 
     int _firstEv;
+    /// Number of the last event returned by NextEvent
+    int _streamEvnum{-1};
+
+    /// File descriptor and read-only mapping of the whole file (mmap mode)
+    int _fd{-1};
+    const uint16_t* _data{nullptr};
+    size_t _mapSize{0};
+    /// Read cursor in datums and the chunk buffer used without a mapping
+    size_t _cursor{0};
+    std::vector<uint16_t> _buffer;
+    /// Datums of the buffer not yet given by NextBlock are [_bufferHead, _bufferTail)
+    size_t _bufferHead{0};
+    size_t _bufferTail{0};
+    /// Asynchronous reader used instead of the mapping when enabled with SetReadAhead
+    std::unique_ptr<ReadAhead> _ahead;
+    /// Archive whose blocks are decompressed into the chunk buffer
+    std::unique_ptr<AqsArchive> _archive;
+    /// archive block held in the buffer, SIZE_MAX if none, and the one read next
+    size_t _bufferBlock{SIZE_MAX};
+    size_t _nextBlock{0};
+    /// compressed or piped input read by _ahead
+    bool _stream{false};
+
+    /// Channel of the event being read, its samples are kept in _waveforms
+    struct HitSlot {
+        unsigned short card, chip, channel;
+        /// time span of the samples, empty when first > last
+        short first, last;
+        /// first and last of the runs of samples of the channel in _runs
+        int32_t firstRun, lastRun;
+    };
+    /// Run of consecutive samples decoded for a channel, linked to the next run of the same channel
+    struct SampleRun {
+        short first, n;
+        int32_t next;
+    };
+    /// Slots indexed with HashChannel with kMaxTimeBins samples each, reused across events.
+    /// Only the slots listed in _touched are filled
+    std::vector<HitSlot> _slots;
+    std::vector<short> _waveforms;
+    std::vector<int32_t> _touched;
+    std::vector<SampleRun> _runs;
+    /// Make room for the slot of the channel hash
+    void GrowSlots(int32_t chHash);
+    /// Build the hits of the filled slots, add them to the event and clear the slots
+    template<typename Event>
+    void CollectHits(Event& event);
+    /// Add the hit of the filled slot whose waveform is wf
+    void AddSlotHit(TRawEvent& event, const HitSlot& slot, const short* wf);
+    void AddSlotHit(CompactEvent& event, const HitSlot& slot, const short* wf);
+    /// Decode the event at the index entry, or the next one in the file order, into a TRawEvent or CompactEvent
+    template<typename Event>
+    bool DecodeEvent(long int id, Event& event);
+    template<typename Event>
+    bool DecodeNextEvent(Event& event);
+
+    /// Map the file, or remap it if the file has grown since the last call
+    bool MapFile();
+    void UnmapFile();
+    /// Move the read cursor to the byte offset in the file
+    void Seek(long int offset);
+    /// Get the next contiguous span of datums starting at the cursor
+    size_t NextBlock(const uint16_t*& block);
+    /// Decompress the archive block into the chunk buffer
+    bool LoadArchiveBlock(size_t i);
+    /// Give back the last n datums of the block, they are returned by the next NextBlock
+    void Unread(size_t n);
+    bool ReadError() const;
+
+    /// Append the start of event to the index unless it repeats the previous one
+    void AddStartOfEvent(const AqsEventRecord& record, int& prevEvnum);
+    /// Scan the mapped file from the datum begin to the end with several threads.
+    /// Return false if the file is too small or a decoding fault was found, nothing is read then
+    bool ScanParallel(size_t begin, std::vector<AqsEventRecord>& events);
+
+    struct ScanState;
+    struct ChunkScan;
+    struct EventState;
+    /// Decoder sinks for the file scan and for the event reading
+    static int ScanSink(void* user, const DatumContext* dc, const DatumItem* item);
+    static int ChunkSink(void* user, const DatumContext* dc, const DatumItem* item);
+    static int StitchSink(void* user, const DatumContext* dc, const DatumItem* item);
+    static int EventSink(void* user, const DatumContext* dc, const DatumItem* item);
 
     static int32_t HashChannel(const int card, const int chip, const int channel);
 };
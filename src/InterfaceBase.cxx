@@ -1,11 +1,158 @@
 #include "InterfaceBase.hxx"
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <sstream>
 
 #include <midasio.h>
 
+#include "TEnv.h"
+#include "TROOT.h"
+
+/// Smallest TTreeCache, for the trees of a few entries
+static const Long64_t kMinCacheSize = 1 << 20;
+
+static std::bitset<80> MakeValidChannels() {
+  std::bitset<80> valid;
+  for (int channel = 3; channel < 79; ++channel)
+    valid[channel] = channel != 15 && channel != 28 && channel != 53 && channel != 66;
+  return valid;
+}
+const std::bitset<80> InterfaceBase::kValidChannels = MakeValidChannels();
+
+//******************************************************************************
+bool InterfaceBase::NextEvent(TRawEvent*& event) {
+//******************************************************************************
+  // interfaces without a streaming reader go through the scanned events
+  if (_nStream < 0) {
+    int nRun;
+    _nStream = (long int)Scan(-1, true, nRun);
+  }
+  if (_nextStream >= _nStream)
+    return false;
+  event = GetEvent(_nextStream++);
+  return true;
+}
+
+//******************************************************************************
+bool InterfaceBase::GetEvent(long int id, PooledEvent& reuse) {
+//******************************************************************************
+  // the hits of the previous event are handed out again by MakeHit, they are detached
+  // first so that the readers reset an event without hits
+  reuse.Release();
+  _hitPool.Recycle();
+  _pooled = true;
+  bool ok = ReadEvent(id, reuse);
+  _pooled = false;
+  if (!ok) {
+    reuse.Release();
+    ResetEvent(reuse, id);
+  }
+  return ok;
+}
+
+//******************************************************************************
+bool InterfaceBase::NextEvent(PooledEvent& reuse) {
+//******************************************************************************
+  reuse.Release();
+  _hitPool.Recycle();
+  _pooled = true;
+  bool ok = ReadNextEvent(reuse);
+  _pooled = false;
+  if (!ok)
+    reuse.Release();
+  return ok;
+}
+
+//******************************************************************************
+bool InterfaceBase::GetEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+  bool ok = ReadEvent(id, event);
+  if (!ok)
+    event.Reset(id);
+  return ok;
+}
+
+//******************************************************************************
+bool InterfaceBase::NextEvent(CompactEvent& event) {
+//******************************************************************************
+  return ReadNextEvent(event);
+}
+
+//******************************************************************************
+bool InterfaceBase::ReadNextEvent(TRawEvent& event) {
+//******************************************************************************
+  if (_nStream < 0) {
+    int nRun;
+    _nStream = (long int)Scan(-1, true, nRun);
+  }
+  if (_nextStream >= _nStream)
+    return false;
+  auto id = _nextStream++;
+  if (!ReadEvent(id, event))
+    ResetEvent(event, id);
+  return true;
+}
+
+//******************************************************************************
+bool InterfaceBase::ReadEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+  bool ok = GetEvent(id, _converted);
+  event.Assign(_converted);
+  return ok;
+}
+
+//******************************************************************************
+bool InterfaceBase::ReadNextEvent(CompactEvent& event) {
+//******************************************************************************
+  bool ok = NextEvent(_converted);
+  event.Assign(_converted);
+  return ok;
+}
+
+//******************************************************************************
+TFile* InterfaceBase::OpenRootFile(const std::string& file_name) const {
+//******************************************************************************
+  // the prefetching thread is attached to the file when it is opened
+  if (_root.prefetch)
+    gEnv->SetValue("TFile.AsyncPrefetching", 1);
+  if (_root.threads > 0 && !ROOT::IsImplicitMTEnabled())
+    ROOT::EnableImplicitMT(_root.threads);
+  return TFile::Open(file_name.c_str());
+}
+
+//******************************************************************************
+void InterfaceBase::SetupTree(TTree* tree, const std::vector<std::string>& branches) const {
+//******************************************************************************
+  // the status is matched by name, the pattern covers the sub-branches of split objects
+  tree->SetBranchStatus("*", false);
+  for (const auto& name : branches)
+    tree->SetBranchStatus((name + "*").c_str(), true);
+  if (_root.cacheSize < 0)
+    return;
+
+  auto size = _root.cacheSize;
+  if (size == 0 && tree->GetEntries() > 0) {
+    // compressed size of the first cluster, the following ones are alike
+    auto cluster = tree->GetClusterIterator(0);
+    cluster.Next();
+    auto entries = std::max<Long64_t>(cluster.GetNextEntry() - cluster.GetStartEntry(), 1);
+    size = tree->GetZipBytes() * entries / tree->GetEntries();
+  }
+  tree->SetCacheSize(std::max(size, kMinCacheSize));
+  for (const auto& name : branches)
+    tree->AddBranchToCache(name.c_str(), true);
+  // the branches are known, no entries are spent learning them
+  tree->StopCacheLearningPhase();
+  // the baskets of the cache are decompressed by the implicit multithreading tasks
+  if (_root.threads > 0)
+    tree->SetParallelUnzip(true);
+  if (_verbose > 0)
+    std::cout << "TTreeCache of " << std::max(size, kMinCacheSize) / 1024 << " kB for " << branches.size()
+              << " branches" << std::endl;
+}
+
 InterfaceTracker::~InterfaceTracker() {
   if (_file.is_open())
     _file.close();
@@ -14,12 +161,26 @@ InterfaceTracker::~InterfaceTracker() {
 //******************************************************************************
 bool InterfaceRawEvent::Initialise(const std::string& file_name, int verbose) {
 //******************************************************************************
-  std::cout << "Initialise TRawEvent interface" << std::endl;
   _verbose = verbose;
-  _file_in = TFile::Open(file_name.c_str());
+  if (_verbose >= 0)
+    std::cout << "Initialise TRawEvent interface" << std::endl;
+  _file_in = OpenRootFile(file_name);
   _tree_in = (TTree*)_file_in->Get("EventTree");
   _event = new TRawEvent();
   _tree_in->SetBranchAddress("TRawEvent", &_event);
+  _eventBranch = _tree_in->GetBranch("TRawEvent");
+
+  _trackerBranch = _tree_in->GetBranch("Tracker");
+  _has_tracker = _trackerBranch != nullptr;
+  if (_has_tracker)
+    _tree_in->SetBranchAddress("Tracker", _pos);
+
+  std::vector<std::string> branches;
+  if (_root.readEvent)
+    branches.emplace_back("TRawEvent");
+  if (_root.readTracker && _has_tracker)
+    branches.emplace_back("Tracker");
+  SetupTree(_tree_in, branches);
 
   return true;
 }
@@ -34,8 +195,48 @@ uint64_t InterfaceRawEvent::Scan(int start, bool refresh, int& Nevents_run) {
 //******************************************************************************
 TRawEvent* InterfaceRawEvent::GetEvent(long int id) {
 //******************************************************************************
-  _tree_in->GetEntry(id);
-  return _event;
+  // the entry is loaded for the cache, only the event branch is read
+  _tree_in->LoadTree(id);
+  _eventBranch->GetEntry(id);
+  // the caller owns the event, the buffer of the branch is overwritten by the next entry
+  return static_cast<TRawEvent*>(_event->Clone());
+}
+
+//******************************************************************************
+bool InterfaceRawEvent::ReadEvent(long int id, TRawEvent& event) {
+//******************************************************************************
+  _tree_in->LoadTree(id);
+  _eventBranch->GetEntry(id);
+  // the hits of the branch buffer are deleted by the next entry, they are copied
+  ResetEvent(event, _event->GetID());
+  event.SetTime(_event->GetTimeMid(), _event->GetTimeMsb(), _event->GetTimeLsb());
+  const auto& hits = _event->GetHits();
+  event.Reserve(hits.size());
+  for (const auto& hit : hits) {
+    const auto& adc = hit->GetADCvector();
+    AddHit(event, hit->GetCard(), hit->GetChip(), hit->GetChannel(), hit->GetTime(), adc, adc.size());
+  }
+  return true;
+}
+
+//******************************************************************************
+bool InterfaceRawEvent::ReadEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+  _tree_in->LoadTree(id);
+  _eventBranch->GetEntry(id);
+  event.Assign(*_event);
+  return true;
+}
+
+//******************************************************************************
+void InterfaceRawEvent::GetTrackerEvent(long int id, Float_t pos[8]) {
+//******************************************************************************
+  if (!_trackerBranch)
+    throw std::logic_error("No tracker info in TRawEvent");
+  _tree_in->LoadTree(id);
+  _trackerBranch->GetEntry(id);
+  for (int i = 0; i < 8; ++i)
+    pos[i] = _pos[i];
 }
 
 //******************************************************************************
@@ -1,8 +1,11 @@
 #ifndef Interface_hxx
 #define Interface_hxx
 
+#include <bitset>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "TTree.h"
 #include "TFile.h"
@@ -13,10 +16,26 @@
 #include "Mapping.h"
 #include "DAQ.h"
 #include "TRawEvent.hxx"
+#include "HitPool.hxx"
+#include "CompactEvent.hxx"
 #include "midasio.h"
+#include "ReadAhead.hxx"
 
 static int tmp = -1;
 
+/// Options of the ROOT inputs
+struct RootReadOptions {
+    /// TTreeCache size in bytes, 0 sizes it to a cluster of the tree and -1 disables it
+    Long64_t cacheSize{0};
+    /// threads of the ROOT implicit multithreading decompressing the baskets, 0 keeps it off
+    int threads{0};
+    /// the baskets of the next cluster are read in the background (TFile.AsyncPrefetching)
+    bool prefetch{false};
+    /// branches to be read, only the ones needed by GetEvent or GetTrackerEvent are activated
+    bool readEvent{true};
+    bool readTracker{true};
+};
+
 
 /// Base interface class
 class InterfaceBase {
@@ -24,7 +43,7 @@ class InterfaceBase {
     InterfaceBase() : _verbose(0) {}
     virtual ~InterfaceBase() = default;
 
-    /// Initialise the reader with file name
+    /// Initialise the reader with file name, a negative verbosity keeps it silent
     virtual bool Initialise(const std::string &file_name, int verbose) = 0;
     //! Scan and define the number of events
     //! \param start the first event to e scan
@@ -32,8 +51,38 @@ class InterfaceBase {
     //! \param Nevents_run update the number of events in the whole run
     //! \return
     virtual uint64_t Scan(int start, bool refresh, int &Nevents_run) = 0;
-    /// Get the data for the particular event
+    //! Take the events found by the Scan of another interface of the same type and file,
+    //! so the interfaces of several threads don't scan the file again.
+    //! Nothing to take by default, the inputs reach their events without a scan
+    virtual void CopyScan(const InterfaceBase &scanned) {}
+    /// Get the data for the particular event, the caller owns the event and its hits
     virtual TRawEvent *GetEvent(long int id) = 0;
+    //! Read the next event in the file order, no Scan is needed.
+    //! Should not be mixed with GetEvent on the same interface
+    //! \param event the decoded event owned by the caller, could be nullptr if the event is broken
+    //! \return false at the end of the input
+    virtual bool NextEvent(TRawEvent *&event);
+    //! Read the event into reuse instead of a new event. The hits are taken from the pool
+    //! of the interface and the previous ones are given back to it, so once the pool has
+    //! grown to the largest event no memory is allocated per event.
+    //! The hits belong to the interface and stay valid until the next call with reuse
+    //! \return false if the event could not be read, reuse is left without hits
+    bool GetEvent(long int id, PooledEvent &reuse);
+    //! NextEvent reading into reuse, with the hits owned as by GetEvent above
+    //! \return false at the end of the input, a broken event is left without hits
+    bool NextEvent(PooledEvent &reuse);
+    //! Read the event into the compact event, its buffers are reused so nothing is allocated
+    //! once they have grown to the largest event
+    //! \return false if the event could not be read, the event is left without hits
+    bool GetEvent(long int id, CompactEvent &event);
+    //! NextEvent reading into the compact event
+    //! \return false at the end of the input, a broken event is left without hits
+    bool NextEvent(CompactEvent &event);
+
+    /// Read the input with the asynchronous read-ahead engine, to be set before Initialise
+    void SetReadAhead(const ReadAheadOptions& options) { _io = options; }
+    /// Cache, branches and threads of the ROOT inputs, to be set before Initialise
+    void SetRootOptions(const RootReadOptions& options) { _root = options; }
 
     bool HasTracker() const { return _has_tracker; }
     virtual void GetTrackerEvent(long int id, Float_t pos[8]) = 0;
@@ -42,6 +91,70 @@ class InterfaceBase {
     /// verbosity level
     int _verbose;
     bool _has_tracker{false};
+    /// read-ahead engine options, disabled by default
+    ReadAheadOptions _io;
+    RootReadOptions _root;
+    /// Number of events returned by NextEvent and the number of events found by its Scan
+    long int _nextStream{0};
+    long int _nStream{-1};
+
+    /// Number of time bins a waveform may span
+    static const int kMaxTimeBins = 512;
+    /// Channels of a chip which are read out, the others are not connected to pads
+    static const std::bitset<80> kValidChannels;
+
+    /// Hits of the events read into reuse, MakeHit takes them from the pool when _pooled is set
+    HitPool _hitPool;
+    bool _pooled{false};
+
+    //! Fill the event with the hits built by MakeHit, the event is reset with its number first
+    //! \return false if the event could not be read
+    virtual bool ReadEvent(long int id, TRawEvent &event) = 0;
+    //! Fill the event with the next one in the file order, as NextEvent
+    //! \return false at the end of the input
+    virtual bool ReadNextEvent(TRawEvent &event);
+    /// Decode into the compact event, by default the TRawEvent read with the hit pool is converted
+    virtual bool ReadEvent(long int id, CompactEvent &event);
+    virtual bool ReadNextEvent(CompactEvent &event);
+    /// Event with pooled hits converted by the default compact readers
+    PooledEvent _converted;
+
+    /// The decoders fill either event type with these
+    void ResetEvent(TRawEvent &event, long int id) {
+        // with _pooled the event is the PooledEvent being read, its hits go back to the pool
+        if (_pooled)
+            static_cast<PooledEvent&>(event).Release();
+        event = TRawEvent(id);
+    }
+    static void ResetEvent(CompactEvent &event, long int id) { event.Reset(id); }
+    template<typename T>
+    void AddHit(TRawEvent &event, int card, int chip, int channel, int time, const T& adc, size_t n) {
+        event.AddHit(MakeHit(card, chip, channel, time, adc, n));
+    }
+    template<typename T>
+    void AddHit(CompactEvent &event, int card, int chip, int channel, int time, const T& adc, size_t n) {
+        event.AddHit(card, chip, channel, time, adc, n);
+    }
+
+    /// Hit of the channel with an empty waveform, taken from _hitPool when _pooled is set
+    TRawHit* NewHit(int card, int chip, int channel) {
+        auto hit = _pooled ? _hitPool.Get(card, chip, channel) : new TRawHit(card, chip, channel);
+        hit->ResetWF();
+        return hit;
+    }
+    /// Build a hit from the waveform span of n samples starting at the time bin time.
+    /// adc is a pointer or any other type indexed by the sample number
+    template<typename T>
+    TRawHit* MakeHit(int card, int chip, int channel, int time, const T& adc, size_t n) {
+        auto hit = NewHit(card, chip, channel);
+        SetWaveformSpan(hit, time, adc, n);
+        return hit;
+    }
+
+    /// Open the ROOT file with the background prefetching if requested
+    TFile* OpenRootFile(const std::string& file_name) const;
+    /// Activate only the branches and fill the TTreeCache with them
+    void SetupTree(TTree* tree, const std::vector<std::string>& branches) const;
 };
 
 class InterfaceRawEvent : public InterfaceBase {
@@ -50,14 +163,22 @@ class InterfaceRawEvent : public InterfaceBase {
     ~InterfaceRawEvent() override = default;
     bool Initialise(const std::string &file_name, int verbose) override;
     uint64_t Scan(int start, bool refresh, int &Nevents_run) override;
+    using InterfaceBase::GetEvent;
     TRawEvent *GetEvent(long int id) override;
-    void GetTrackerEvent(long int id, Float_t pos[8]) override {
-        throw std::logic_error("No tracker info in TRawEvent");
-    }
+    /// Tracker positions stored next to the events, read without the event branch
+    void GetTrackerEvent(long int id, Float_t pos[8]) override;
+ protected:
+    /// The hits of the branch buffer are copied to the ones of the pool
+    bool ReadEvent(long int id, TRawEvent &event) override;
+    /// The branch buffer is converted without a copy of its hits
+    bool ReadEvent(long int id, CompactEvent &event) override;
  private:
     TFile *_file_in;
     TTree *_tree_in;
     TRawEvent *_event;
+    TBranch *_eventBranch{nullptr};
+    TBranch *_trackerBranch{nullptr};
+    Float_t _pos[8];
 };
 
 /// Silicon tracker file reader
@@ -80,6 +201,10 @@ class InterfaceTracker : public InterfaceBase {
     void GotoEvent(unsigned int num);
     bool HasEvent(long int id);
 
+ protected:
+    /// There is no TPC event in the tracker file
+    bool ReadEvent(long int id, TRawEvent &event) override { return false; }
+
  private:
     ifstream _file;
     std::map<long int, int> _eventPos;
@@ -16,7 +16,9 @@
 class InterfaceFactory {
  public:
     static std::shared_ptr<InterfaceBase> get(const TString &file_name) {
-        if (file_name.EndsWith(".aqs")) {
+        // "-" is an AQS stream on the standard input
+        if (file_name.EndsWith(".aqs") || file_name.EndsWith(".aqs.lz4") || file_name.EndsWith(".aqs.gz") ||
+            file_name.EndsWith(".aqs.bz2") || file_name.EqualTo("-")) {
             return std::make_shared<InterfaceAQS>();
         }
         if (file_name.EndsWith(".mid.lz4")) {
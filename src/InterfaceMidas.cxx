@@ -2,236 +2,441 @@
 // Created by SERGEY SUVOROV on 29/08/2022.
 //
 
+#include <algorithm>
 #include <bitset>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "InterfaceMidas.hxx"
 
+/// Tags of the banks used by the unpacker, the other banks are not recorded
+static constexpr uint32_t kBankCOUN = TMBankTag("COUN");
+static constexpr uint32_t kBankNWAV = TMBankTag("NWAV");
+static constexpr uint32_t kBankTMSB = TMBankTag("TMSB");
+static constexpr uint32_t kBankTMID = TMBankTag("TMID");
+static constexpr uint32_t kBankTLSB = TMBankTag("TLSB");
+static constexpr uint32_t kBankNADC = TMBankTag("NADC");
+static constexpr uint32_t kBankWAVE = TMBankTag("WAVE");
+static constexpr uint32_t kBankFEMC = TMBankTag("FEMC");
+static constexpr uint32_t kBankCHIP = TMBankTag("CHIP");
+static constexpr uint32_t kBankCHAN = TMBankTag("CHAN");
+static constexpr uint32_t kBankTBIN = TMBankTag("TBIN");
+static constexpr uint32_t kBankCHID = TMBankTag("CHID");
+static constexpr uint32_t kBankTMIN = TMBankTag("TMIN");
+
+//******************************************************************************
+InterfaceMidas::InterfaceMidas() {
+//******************************************************************************
+    SelectBanks(_currentEvent);
+}
+
+//******************************************************************************
+void InterfaceMidas::SelectBanks(TMEvent& event) {
+//******************************************************************************
+    event.SelectBanks({kBankCOUN, kBankNWAV, kBankTMSB, kBankTMID, kBankTLSB,
+                       kBankNADC, kBankWAVE, kBankFEMC, kBankCHIP, kBankCHAN, kBankTBIN,
+                       kBankCHID, kBankTMIN});
+}
+
+//******************************************************************************
+InterfaceMidas::~InterfaceMidas() {
+//******************************************************************************
+    delete _reader;
+}
+
 //******************************************************************************
 bool InterfaceMidas::Initialise(const std::string& file_name, int verbose) {
 //******************************************************************************
     if (file_name == "")
         return false;
-    _reader = TMNewReader(file_name.c_str());
+    _filename = file_name;
+    _reader = OpenReader();
     _verbose = verbose;
     if (_reader->fError) {
         std::cout << "Cannot open input file " <<  file_name << std::endl;
         delete _reader;
+        _reader = nullptr;
         return false;
     }
-    std::cout << "Opened " <<  file_name << std::endl;
-    _filename = file_name;
+    if (_verbose >= 0)
+        std::cout << "Opened " <<  file_name << std::endl;
     return true;
 }
 
 //******************************************************************************
-uint64_t InterfaceMidas::Scan(int start, bool refresh, int& Nevents_run) {
+MidasFileReader* InterfaceMidas::OpenReader() {
 //******************************************************************************
+    auto reader = new MidasFileReader(_filename, _io);
+    reader->SetCheckpoints(&_checkpoints, false);
+    return reader;
+}
 
-    unsigned int events_number = 0;
-    if (start < _currentEventIndex){
-        delete _reader;
-        _reader = TMNewReader(_filename.c_str());
-        _currentEventIndex = 0;
-    }
-//    uint64_t number = 0;
-    while (true) {
-        _currentEvent = TMReadEvent(_reader);
-
-        if (!_currentEvent) {
-            // EOF
-            delete _currentEvent;
-            break;
+//******************************************************************************
+uint64_t InterfaceMidas::Scan(int start, bool refresh, int& Nevents_run) {
+//******************************************************************************
+    if (refresh) {
+        _eventOffsets.clear();
+        _checkpoints.clear();
+        if (MidasIndex::Load(_filename, _checkpoints, _eventOffsets)) {
+            if (_verbose > 0)
+                std::cout << "Index " << MidasIndex::GetName(_filename) << " is used" << std::endl;
+            _currentEventIndex = -1;
+            Nevents_run = _eventOffsets.size();
+            return _eventOffsets.size();
         }
+    }
 
-        if (_currentEvent->error) {
-            // broken event
-            printf("event with error, bye!\n");
-            delete _currentEvent;
-            break;
+    // the scan restarts at the requested event, the ones before are already indexed
+    size_t first = 0;
+    if (start > 0 && !_eventOffsets.empty())
+        first = std::min<size_t>(start, _eventOffsets.size() - 1);
+    uint64_t position = first < _eventOffsets.size() ? _eventOffsets[first] : 0;
+    _eventOffsets.resize(first);
+
+    _reader->SetCheckpoints(&_checkpoints, true);
+    if (_reader->Seek(position)) {
+        // only the event headers are read, the banks are skipped in the decompressed data
+        char header[16];
+        while (true) {
+            auto offset = _reader->Position();
+            auto rd = _reader->Read(header, sizeof(header));
+            if (rd <= 0) {
+                // EOF
+                break;
+            }
+            uint32_t data_size;
+            memcpy(&data_size, header + 12, sizeof(data_size));
+            if (rd != sizeof(header) || !_reader->Skip(data_size)) {
+                // broken event
+                printf("event with error, bye!\n");
+                break;
+            }
+            _eventOffsets.push_back(offset);
         }
-        _currentEventIndex++;
-        events_number++;
     }
-    Nevents_run = events_number; /// TODO Multiple files non-supported
-    return events_number;
+    _reader->SetCheckpoints(&_checkpoints, false);
+
+    if (!MidasIndex::Save(_filename, _checkpoints, _eventOffsets) && _verbose > 0)
+        std::cout << "Index " << MidasIndex::GetName(_filename) << " could not be written" << std::endl;
+
+    // the reader is at the end of the file, the events are then read through the index
+    _currentEventIndex = -1;
+    Nevents_run = _eventOffsets.size(); /// TODO Multiple files non-supported
+    return _eventOffsets.size();
+}
+
+//******************************************************************************
+void InterfaceMidas::CopyScan(const InterfaceBase& scanned) {
+//******************************************************************************
+    auto& midas = dynamic_cast<const InterfaceMidas&>(scanned);
+    // the reader restarts from the copied checkpoints
+    _eventOffsets = midas._eventOffsets;
+    _checkpoints = midas._checkpoints;
+    _currentEventIndex = -1;
 }
 
 TRawEvent* InterfaceMidas::GetEvent(long id) {
+    auto event = new TRawEvent();
+    if (!ReadEvent(id, *event)) {
+        delete event;
+        return nullptr;
+    }
+    return event;
+}
+
+//******************************************************************************
+bool InterfaceMidas::ReadEvent(long int id, TRawEvent& event) {
+//******************************************************************************
     TMEvent* midas_event = GoToEvent(id);
     if (midas_event == nullptr){
         std::cerr << "Cannot go to event id " << id << std::endl;
         exit(1);
     }
+    return Unpack(midas_event, id, event);
+}
+
+//******************************************************************************
+bool InterfaceMidas::ReadEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+    TMEvent* midas_event = GoToEvent(id);
+    if (midas_event == nullptr){
+        std::cerr << "Cannot go to event id " << id << std::endl;
+        exit(1);
+    }
+    return Unpack(midas_event, id, event);
+}
+
+//******************************************************************************
+bool InterfaceMidas::NextEvent(TRawEvent*& event) {
+//******************************************************************************
+    // events are read one after another, the reader is never rewound
+    _currentEventIndex = -1;
+    if (!TMReadEventInto(_reader, _currentEvent) || _currentEvent.error)
+        return false;
+    event = Unpack(&_currentEvent, _nextStream++);
+    return true;
+}
+
+//******************************************************************************
+bool InterfaceMidas::ReadNextEvent(TRawEvent& event) {
+//******************************************************************************
+    _currentEventIndex = -1;
+    if (!TMReadEventInto(_reader, _currentEvent) || _currentEvent.error)
+        return false;
+    // a broken event is kept without hits
+    if (!Unpack(&_currentEvent, _nextStream, event))
+        ResetEvent(event, _nextStream);
+    ++_nextStream;
+    return true;
+}
+
+//******************************************************************************
+bool InterfaceMidas::ReadNextEvent(CompactEvent& event) {
+//******************************************************************************
+    _currentEventIndex = -1;
+    if (!TMReadEventInto(_reader, _currentEvent) || _currentEvent.error)
+        return false;
+    if (!Unpack(&_currentEvent, _nextStream, event))
+        event.Reset(_nextStream);
+    ++_nextStream;
+    return true;
+}
+
+/// Little-endian array stored in a midas bank, read in place
+template<typename T>
+class BankSpan {
+ public:
+    BankSpan(TMEvent* event, const TMBank* bank)
+        : _data(bank ? event->GetBankData(bank) : nullptr),
+          _size(bank ? bank->data_size / sizeof(T) : 0) {}
+    BankSpan(const char* data, size_t size) : _data(data), _size(size) {}
+
+    T operator[](size_t i) const {
+        T value;
+        memcpy(&value, _data + i * sizeof(T), sizeof(T));
+        return value;
+    }
+    /// The elements from offset on
+    BankSpan Sub(size_t offset) const { return BankSpan(_data + offset * sizeof(T), _size - offset); }
+    size_t size() const { return _size; }
+    const char* data() const { return _data; }
+
+ private:
+    const char* _data;
+    size_t _size;
+};
+
+//******************************************************************************
+template<typename Event>
+void InterfaceMidas::FillHitsV1(Event& event, TMEvent* midas_event, unsigned int waveforms) {
+//******************************************************************************
+    BankSpan<uint8_t> femc(midas_event, midas_event->FindBank(kBankFEMC));
+    BankSpan<uint8_t> chip(midas_event, midas_event->FindBank(kBankCHIP));
+    BankSpan<uint8_t> chan(midas_event, midas_event->FindBank(kBankCHAN));
+    BankSpan<uint8_t> nadc(midas_event, midas_event->FindBank(kBankNADC));
+    BankSpan<uint16_t> tbin(midas_event, midas_event->FindBank(kBankTBIN));
+    BankSpan<uint16_t> wave(midas_event, midas_event->FindBank(kBankWAVE));
+    if (femc.size() < waveforms || chip.size() < waveforms || chan.size() < waveforms || nadc.size() < waveforms) {
+        std::cerr << "Banks of event " << event.GetID() << " are shorter than " << waveforms << " waveforms" << std::endl;
+        return;
+    }
+
+    for (unsigned int i = 0; i < waveforms; i++) {
+        if (chan[i] >= kValidChannels.size() || !kValidChannels[chan[i]])
+            continue;
+        size_t samples = std::min<size_t>(nadc[i], std::min(tbin.size(), wave.size()));
+        AddTimeBinHit(event, femc[i], chip[i], chan[i], tbin, wave, samples);
+    }
+}
+
+//******************************************************************************
+template<typename Span>
+void InterfaceMidas::AddTimeBinHit(TRawEvent& event, int card, int chip, int channel,
+                                   const Span& tbin, const Span& wave, size_t samples) {
+//******************************************************************************
+    // the time bins missing between the runs stay unset, as the AQS hits
+    auto hit = NewHit(card, chip, channel);
+    size_t start = 0;
+    for (size_t j = 0; j < samples; ++j) {
+        if (tbin[j] >= kMaxTimeBins) {
+            start = j + 1;
+            continue;
+        }
+        // the run ends at the last sample, before a jump of the time bin or at the last bin
+        if (j + 1 == samples || tbin[j + 1] != tbin[j] + 1 || tbin[j] + 1 == kMaxTimeBins) {
+            SetWaveformSpan(hit, tbin[start], wave.Sub(start), j + 1 - start);
+            start = j + 1;
+        }
+    }
+    event.AddHit(hit);
+}
+
+//******************************************************************************
+template<typename Span>
+void InterfaceMidas::AddTimeBinHit(CompactEvent& event, int card, int chip, int channel,
+                                   const Span& tbin, const Span& wave, size_t samples) {
+//******************************************************************************
+    int first = kMaxTimeBins, last = -1;
+    for (size_t j = 0; j < samples; ++j) {
+        if (tbin[j] >= kMaxTimeBins)
+            continue;
+        first = std::min(first, (int)tbin[j]);
+        last = std::max(last, (int)tbin[j]);
+    }
+    if (last < 0)
+        first = last + 1;
+    // the new samples of the compact event are zeros, only the present time bins are written
+    auto adc = event.AddHit(card, chip, channel, first, last - first + 1);
+    for (size_t j = 0; j < samples; ++j)
+        if (tbin[j] < kMaxTimeBins)
+            adc[tbin[j] - first] = wave[j];
+}
+
+//******************************************************************************
+template<typename Event>
+void InterfaceMidas::FillHitsV2(Event& event, TMEvent* midas_event, unsigned int waveforms) {
+//******************************************************************************
+    BankSpan<uint16_t> chid(midas_event, midas_event->FindBank(kBankCHID));
+    BankSpan<uint16_t> tmin(midas_event, midas_event->FindBank(kBankTMIN));
+    BankSpan<uint8_t> nadc(midas_event, midas_event->FindBank(kBankNADC));
+    BankSpan<uint16_t> wave(midas_event, midas_event->FindBank(kBankWAVE));
+    if (chid.size() < waveforms || tmin.size() < waveforms || nadc.size() < waveforms) {
+        std::cerr << "Banks of event " << event.GetID() << " are shorter than " << waveforms << " waveforms" << std::endl;
+        return;
+    }
+
+    // the channel ids are split with shifts and masks over the whole CHID bank
+    _card.resize(waveforms);
+    _chip.resize(waveforms);
+    _chan.resize(waveforms);
+    unsigned int i = 0;
+#if defined(__SSE2__)
+    const __m128i mask_card = _mm_set1_epi16(0x7);
+    const __m128i mask_chip = _mm_set1_epi16(0xF);
+    const __m128i mask_chan = _mm_set1_epi16(0x7F);
+    for (; i + 8 <= waveforms; i += 8) {
+        __m128i id = _mm_loadu_si128((const __m128i*)(chid.data() + 2 * i));
+        _mm_storeu_si128((__m128i*)&_card[i], _mm_and_si128(_mm_srli_epi16(id, 11), mask_card));
+        _mm_storeu_si128((__m128i*)&_chip[i], _mm_and_si128(_mm_srli_epi16(id, 7), mask_chip));
+        _mm_storeu_si128((__m128i*)&_chan[i], _mm_and_si128(id, mask_chan));
+    }
+#endif
+    for (; i < waveforms; i++) {
+        auto id = chid[i];
+        _card[i] = (id >> 11) & 0x7;
+        _chip[i] = (id >> 7) & 0xF;
+        _chan[i] = id & 0x7F;
+    }
+
+    // the samples of the waveforms follow each other in the WAVE bank
+    size_t counter_adc = 0;
+    for (i = 0; i < waveforms; i++) {
+        size_t n = nadc[i];
+        if (counter_adc + n > wave.size()) {
+            std::cerr << "WAVE bank of event " << event.GetID() << " is too short" << std::endl;
+            return;
+        }
+        if (_chan[i] < kValidChannels.size() && kValidChannels[_chan[i]])
+            AddHit(event, _card[i], _chip[i], _chan[i], tmin[i], wave.Sub(counter_adc), n);
+        counter_adc += n;
+    }
+}
+
+TRawEvent* InterfaceMidas::Unpack(TMEvent* midas_event, long id) {
+    auto event = new TRawEvent();
+    if (!Unpack(midas_event, id, *event)) {
+        delete event;
+        return nullptr;
+    }
+    return event;
+}
+
+bool InterfaceMidas::Unpack(TMEvent* midas_event, long id, TRawEvent& event) {
+    return UnpackEvent(midas_event, id, event);
+}
+
+bool InterfaceMidas::Unpack(TMEvent* midas_event, long id, CompactEvent& event) {
+    return UnpackEvent(midas_event, id, event);
+}
+
+template<typename Event>
+bool InterfaceMidas::UnpackEvent(TMEvent* midas_event, long id, Event& event) {
     midas_event->FindAllBanks();
     if (midas_event->error){
 //        std::cerr << "Error with banks of event " << id << std::endl;
-        return nullptr;
+        return false;
     }
 
 
     /// Get event number
-    auto bank_count = midas_event->FindBank("COUN");
+    auto bank_count = midas_event->FindBank(kBankCOUN);
     unsigned int event_number = 0;
     event_number = GetUIntFromBank(midas_event->GetBankData(bank_count));
 
     if (event_number != id){std::cout << "Error " << id << "\t" << "\t" << std::bitset<32>(id) << "\t" << std::bitset<32>(event_number)
                                       << "\t" << std::bitset<8>(midas_event->GetBankData(bank_count)[3]) << std::bitset<8>(midas_event->GetBankData(bank_count)[2]) << std::bitset<8>(midas_event->GetBankData(bank_count)[1]) << std::bitset<8>(midas_event->GetBankData(bank_count)[0]) << std::endl;}
 
-    /// Define TRawEvent
-    auto event = new TRawEvent(event_number);
-
-    /// Get timing of the event
-    auto bank_tmsb = midas_event->FindBank("TMSB");
-    auto tmsb = GetUShortFromBank(midas_event->GetBankData(bank_tmsb));
-    auto bank_tmid = midas_event->FindBank("TMID");
-    auto tmid = GetUShortFromBank(midas_event->GetBankData(bank_tmid));
-    auto bank_tlsb = midas_event->FindBank("TLSB");
-    auto tlsb = GetUShortFromBank(midas_event->GetBankData(bank_tlsb));
-    event->SetTime(tmid,tmsb,tlsb);
-//    std::cout << "-> Times: " << tmsb << "\t" << tmid << "\t" << tlsb << std::endl;
-
     /// Get number of waveforms
-    auto bank_nwav = midas_event->FindBank("NWAV");
+    auto bank_nwav = midas_event->FindBank(kBankNWAV);
     auto waveformsNumber = GetUShortFromBank(midas_event->GetBankData(bank_nwav));
     if (waveformsNumber <= 0){
         std::cout << "No waveform in event " << id << std::endl;
-        return nullptr;
-    }
-//    std::cout << "-> Number of waveforms: " << waveformsNumber << std::endl;
-
-    /// Common to both versions
-    auto bank_wave = midas_event->FindBank("WAVE");
-    auto bank_nadc = midas_event->FindBank("NADC");
-
-    unsigned short version = 0;
-    /// version 1
-    auto bank_femc = midas_event->FindBank("FEMC");
-    auto bank_chip = midas_event->FindBank("CHIP");
-    auto bank_chan = midas_event->FindBank("CHAN");
-    auto bank_tbin = midas_event->FindBank("TBIN");
-    if (bank_femc){
-        version = 1;
-        std::cout << "Using version 1" << std::endl;
-    }
-    /// version 2
-    auto bank_chid = midas_event->FindBank("CHID");
-    auto bank_tmin = midas_event->FindBank("TMIN");
-    auto bank_tmax = midas_event->FindBank("TMAX");
-    if (bank_chid and version == 0) {
-        version = 2;
-        std::cout << "Using version 2" << std::endl;
+        return false;
     }
 
-//    event->Reserve(waveformsNumber);
-    TRawHit* hit;
-
-    std::vector<unsigned short> femc_vector, chip_vector, chan_vector, chid_vector, nadc_vector, tbin_vector, tmin_vector, wave_vector;
-
-    nadc_vector = GetUCharVectorFromBank(midas_event->GetBankData(bank_nadc), waveformsNumber);
-    unsigned int total_size_wave = 0;
-    for (unsigned int i =0; i < waveformsNumber; i++) total_size_wave+=nadc_vector[i];
-    std::cout <<"Total number of ADC counts: " << total_size_wave << std::endl;
-    std::cout <<"Number waves: " << waveformsNumber << std::endl;
-    wave_vector = GetUShortVectorFromBank(midas_event->GetBankData(bank_wave), total_size_wave);
+    /// Define TRawEvent
+    ResetEvent(event, event_number);
 
-    std::cout << "here" << std::endl;
-    if (version == 1){
-        femc_vector = GetUCharVectorFromBank(midas_event->GetBankData(bank_femc), waveformsNumber);
-        chip_vector = GetUCharVectorFromBank(midas_event->GetBankData(bank_chip), waveformsNumber);
-        chan_vector = GetUCharVectorFromBank(midas_event->GetBankData(bank_chan), waveformsNumber);
-        tbin_vector = GetUShortVectorFromBank(midas_event->GetBankData(bank_tbin), waveformsNumber);
-    }
-    else if (version == 2) {
-        chid_vector = GetUShortVectorFromBank(midas_event->GetBankData(bank_chid), waveformsNumber);
-        tmin_vector = GetUShortVectorFromBank(midas_event->GetBankData(bank_tmin), waveformsNumber); // we use the number of adc instead of the tmax
-        femc_vector.resize(waveformsNumber);
-        chip_vector.resize(waveformsNumber);
-        chan_vector.resize(waveformsNumber);
-        for (unsigned int i = 0; i < waveformsNumber; i++) {
-            femc_vector[i] = ExtractFemCard(chid_vector[i]);
-            chip_vector[i] = ExtractChipId(chid_vector[i]);
-            chan_vector[i] = ExtractChanId(chid_vector[i]);
-        }
-    }
+    /// Get timing of the event
+    auto bank_tmsb = midas_event->FindBank(kBankTMSB);
+    auto tmsb = GetUShortFromBank(midas_event->GetBankData(bank_tmsb));
+    auto bank_tmid = midas_event->FindBank(kBankTMID);
+    auto tmid = GetUShortFromBank(midas_event->GetBankData(bank_tmid));
+    auto bank_tlsb = midas_event->FindBank(kBankTLSB);
+    auto tlsb = GetUShortFromBank(midas_event->GetBankData(bank_tlsb));
+    event.SetTime(tmid,tmsb,tlsb);
+
+    event.Reserve(waveformsNumber);
+    /// version 1 has a bank per channel id field, version 2 packs them in CHID
+    if (midas_event->FindBank(kBankFEMC))
+        FillHitsV1(event, midas_event, waveformsNumber);
+    else if (midas_event->FindBank(kBankCHID))
+        FillHitsV2(event, midas_event, waveformsNumber);
     else {
-        std::cerr << "Version " << version << " not implemented!";
+        std::cerr << "Version " << 0 << " not implemented!";
         exit(1);
     }
-    unsigned int wave_counter = 0;
-    unsigned int counter_adc = 0;
-    for (int i =0; i < waveformsNumber; i++) {
-
-        if (chan_vector[i] == 15 or chan_vector[i] == 28 or chan_vector[i] == 53 or chan_vector[i] == 66 or chan_vector[i] <= 2 or chan_vector[i] >= 79)
-        {
-            std::cout << "Cannot process this channel: " << chan_vector[i] << std::endl;
-            continue;
-        }
-        if (version == 1){
-            hit = new TRawHit(femc_vector[i], chip_vector[i], chan_vector[i]);
-            std::vector<unsigned int> adc_vector;
-            adc_vector.resize(540);
-            adc_vector.clear();
-            hit->ResetWF();
-            for (int jtbin = 0; jtbin < nadc_vector[i]; jtbin++){
-                hit->SetADCunit(tbin_vector[jtbin], wave_vector[jtbin]);
-            }
-        }
-        else if (version == 2){
-            std::cout << femc_vector[i] << "\t" << chip_vector[i] << "\t" << chan_vector[i] << std::endl;
-            hit = new TRawHit(femc_vector[i], chip_vector[i], chan_vector[i]);
-            std::vector<unsigned int> adc_vector;
-            adc_vector.resize(540);
-            adc_vector.clear();
-            hit->ResetWF();
-            for (int jtbin = 0; jtbin < nadc_vector[i]; jtbin++){
-                //std::cout << counter_adc+jtbin << "\t" << tmin_vector[i]+jtbin << "\t" << wave_vector[counter_adc+jtbin] << std::endl;
-                hit->SetADCunit(tmin_vector[i]+jtbin, wave_vector[counter_adc+jtbin]);
-            }
-            counter_adc+= nadc_vector[i];
-        }
-        hit->ShrinkWF();
-        event->AddHit(hit);
-    }
-    return event;
+    return true;
 
 }
 
 TMEvent* InterfaceMidas::GoToEvent(long id) {
 
-    // if the index is too far away, we need to move to the right location
-    if (id < _currentEventIndex){
-        delete _reader;
-        _reader = TMNewReader(_filename.c_str());
-        _currentEvent = TMReadEvent(_reader);
-        if (!IsValid(_currentEvent)) {
-            // EOF
-            _currentEvent = nullptr;
-            std::cerr << "End of file was reached during initialization" << std::endl;
-            return nullptr;
-        }
-        _currentEventIndex = 0;
-    }
+    // if the current index is the right one, nothing to do
+    if (id == _currentEventIndex)
+        return &_currentEvent;
 
-    /// TODO there might be a better way to go to an event, but the midasio lib doesn't allow this with a user-friendly method
-//    TMEvent *e = nullptr;
-    while (id > _currentEventIndex){
-        _currentEvent = TMReadEvent(_reader); // read but drops the event
-        if (!IsValid(_currentEvent)) {
-            // EOF
-            std::cerr << "End of file was reached while " << id << " was requested!" << std::endl;
-            return nullptr;
-        }
-        _currentEventIndex++;
+    if (id < 0 || id >= (long)_eventOffsets.size()) {
+        std::cerr << "Event id " << id << " is not among the " << _eventOffsets.size() << " indexed events" << std::endl;
+        return nullptr;
     }
-    // if the current index is the right one, nothing to do
-    if (id == _currentEventIndex){
-        return _currentEvent;
+
+    // the reader restarts at the LZ4 block owning the event or simply reads on
+    if (!_reader->Seek(_eventOffsets[id])) {
+        std::cerr << "Cannot move to the offset " << _eventOffsets[id] << " of event " << id << std::endl;
+        return nullptr;
     }
-    else {
-        std::cerr << "Event id " << _currentEventIndex << " was found while " << id << " was requested!" << std::endl;
+    bool read = TMReadEventInto(_reader, _currentEvent);
+    if (!IsValid(read ? &_currentEvent : nullptr)) {
+        // EOF
+        _currentEventIndex = -1;
+        std::cerr << "End of file was reached while " << id << " was requested!" << std::endl;
         return nullptr;
     }
-    return nullptr;
+    _currentEventIndex = id;
+    return &_currentEvent;
 }
 
 
@@ -244,7 +449,6 @@ bool InterfaceMidas::IsValid(TMEvent* event) {
     if (event->error) {
         // broken event
         printf("event with error, bye!\n");
-        delete event;
         return false;
     }
     return true;
@@ -266,48 +470,3 @@ unsigned short InterfaceMidas::GetUShortFromBank(char * data) {
         ((unsigned char)data[0] << 0));
     return value;
 }
-
-std::vector<unsigned short> InterfaceMidas::GetUShortVectorFromBank(char * data, unsigned int nvalues) {
-    std::vector<unsigned short> vector;
-    vector.resize(nvalues);
-    for (int i = 0; i < nvalues; i++){
-        vector[i] = (unsigned short)(((unsigned char)data[2*i+1] << 8) +
-            ((unsigned char)data[2*i] << 0));
-    }
-    return vector;
-}
-
-unsigned short InterfaceMidas::ExtractFemCard(unsigned short data) {
-    auto bits = std::bitset<16>(data);
-    return (unsigned short) ((bits.test(11) << 0) +
-        (bits.test(12) << 1) +
-        (bits.test(13) << 2));
-}
-
-unsigned short InterfaceMidas::ExtractChipId(unsigned short data) {
-    auto bits = std::bitset<16>(data);
-    return (unsigned short) ((bits.test(7) << 0) +
-        (bits.test(8) << 1) +
-        (bits.test(9) << 2) +
-        (bits.test(10) << 3));
-}
-
-unsigned short InterfaceMidas::ExtractChanId(unsigned short data) {
-    auto bits = std::bitset<16>(data);
-    return (unsigned short) ((bits.test(0) << 0) +
-        (bits.test(1) << 1) +
-        (bits.test(2) << 2) +
-        (bits.test(3) << 3) +
-        (bits.test(4) << 4) +
-        (bits.test(5) << 5) +
-        (bits.test(6) << 6));
-}
-
-std::vector<unsigned short> InterfaceMidas::GetUCharVectorFromBank(char * data, unsigned int nvalues) {
-    std::vector<unsigned short> vector;
-    vector.resize(nvalues);
-    for (int i = 0; i < nvalues; i++){
-        vector[i] = (unsigned short)((unsigned char)data[i] << 0);
-    }
-    return vector;
-}
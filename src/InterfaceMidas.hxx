@@ -6,39 +6,78 @@
 #define DAQ_READER_SRC_INTERFACEMIDAS_HXX_
 
 #include "InterfaceBase.hxx"
+#include "MidasFileReader.hxx"
 
 /// Midas file reader
 
 class InterfaceMidas : public InterfaceBase {
  public:
-    explicit InterfaceMidas(){_currentEvent = new TMEvent();};
-    ~InterfaceMidas() override = default;
+    explicit InterfaceMidas();
+    ~InterfaceMidas() override;
     bool Initialise(const std::string &file_name, int verbose) override;
     uint64_t Scan(int start, bool refresh, int &Nevents_run) override;
+    void CopyScan(const InterfaceBase &scanned) override;
+    using InterfaceBase::GetEvent;
+    using InterfaceBase::NextEvent;
     TRawEvent *GetEvent(long int id) override;
+    bool NextEvent(TRawEvent *&event) override;
     void GetTrackerEvent(long int id, Float_t pos[8]) override {
         throw std::logic_error("No tracker info in TRawEvent");
     }
 
+    /// Convert the banks of the midas event. The instances don't share any state,
+    /// so the events could be unpacked by several threads with an instance each
+    TRawEvent* Unpack(TMEvent* midas_event, long int id);
+    /// Unpack into the given event, false if the event is broken
+    bool Unpack(TMEvent* midas_event, long int id, TRawEvent& event);
+    /// Unpack into the compact event, the WAVE samples are copied without a TRawHit
+    bool Unpack(TMEvent* midas_event, long int id, CompactEvent& event);
+    /// Record only the banks used by Unpack when the event is read
+    static void SelectBanks(TMEvent& event);
+
+ protected:
+    bool ReadEvent(long int id, TRawEvent &event) override;
+    bool ReadNextEvent(TRawEvent &event) override;
+    bool ReadEvent(long int id, CompactEvent &event) override;
+    bool ReadNextEvent(CompactEvent &event) override;
+
  private:
+    /// Open the file with the read-ahead engine if it is enabled
+    MidasFileReader* OpenReader();
+    /// Read the event at the offset stored in the index
     TMEvent* GoToEvent(long int id);
     bool IsValid(TMEvent*);
+    template<typename Event>
+    bool UnpackEvent(TMEvent* midas_event, long int id, Event& event);
+    /// Build the hits from the banks of the version 1 or 2 into a TRawEvent or CompactEvent
+    template<typename Event>
+    void FillHitsV1(Event& event, TMEvent* midas_event, unsigned int waveforms);
+    template<typename Event>
+    void FillHitsV2(Event& event, TMEvent* midas_event, unsigned int waveforms);
+    /// Add the hit of the version 1 samples that come with their time bins. The TRawHit gets
+    /// the runs of consecutive time bins only, the compact hit a span with zeros between them
+    template<typename Span>
+    void AddTimeBinHit(TRawEvent& event, int card, int chip, int channel, const Span& tbin, const Span& wave, size_t samples);
+    template<typename Span>
+    void AddTimeBinHit(CompactEvent& event, int card, int chip, int channel, const Span& tbin, const Span& wave, size_t samples);
     unsigned int GetUIntFromBank(char*);
     unsigned short GetUShortFromBank(char*);
-    std::vector<unsigned short> GetUShortVectorFromBank(char*, unsigned int = 0);
-    std::vector<unsigned short> GetUCharVectorFromBank(char*, unsigned int = 0);
-    unsigned short ExtractFemCard(unsigned short data);
-    unsigned short ExtractChipId(unsigned short data);
-    unsigned short ExtractChanId(unsigned short data);
-//    std::vector<unsigned short> GetFemCardVectorFromBank(char*, unsigned int = 0);
-//    std::vector<unsigned short> GetChipVectorFromBank(char*, unsigned int = 0);
-//    std::vector<unsigned short> GetChanVectorFromBank(char*, unsigned int = 0);
 
  private:
     std::string _filename;
-    TMReaderInterface* _reader;
-    unsigned int _currentEventIndex{0};
-    TMEvent* _currentEvent{};
+    MidasFileReader* _reader{nullptr};
+    /// offset of each event in the decompressed data, filled by Scan
+    std::vector<uint64_t> _eventOffsets;
+    /// restart points of the decoding of the file
+    std::vector<MidasCheckpoint> _checkpoints;
+    /// index of the event held in _currentEvent, -1 if there is none
+    long int _currentEventIndex{-1};
+    /// the events are read into this one, its buffer is reused
+    TMEvent _currentEvent;
+    /// card, chip and channel of the waveforms of the event
+    std::vector<unsigned short> _card;
+    std::vector<unsigned short> _chip;
+    std::vector<unsigned short> _chan;
 //    TTree *_tree_in;
     TRawEvent *_event;
 
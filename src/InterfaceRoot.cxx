@@ -4,36 +4,106 @@
 
 #include "InterfaceRoot.hxx"
 
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// Whether any of the n amplitudes is above zero
+static bool HasSignal(const int* ampl, int n) {
+    int k = 0;
+#if defined(__SSE2__)
+    // 16 amplitudes per step, most pads are empty and are read to the end
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 16 <= n; k += 16) {
+        auto a = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(ampl + k)), zero);
+        auto b = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(ampl + k + 4)), zero);
+        auto c = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(ampl + k + 8)), zero);
+        auto d = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(ampl + k + 12)), zero);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))))
+            return true;
+    }
+#endif
+    for (; k < n; ++k)
+        if (ampl[k] > 0)
+            return true;
+    return false;
+}
+
+/// Index of the first non-zero amplitude, n if there is none
+static int FirstNonZero(const int* ampl, int n) {
+    int k = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 4 <= n; k += 4) {
+        auto mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(ampl + k)), zero));
+        if (mask != 0xFFFF)
+            return k + (__builtin_ctz(~mask & 0xFFFF) >> 2);
+    }
+#endif
+    while (k < n && ampl[k] == 0)
+        ++k;
+    return k;
+}
+
+/// Index of the last non-zero amplitude, -1 if there is none
+static int LastNonZero(const int* ampl, int n) {
+    int k = n;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; k >= 4; k -= 4) {
+        auto mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(ampl + k - 4)), zero));
+        if (mask != 0xFFFF)
+            return k - 1 - (__builtin_clz((unsigned)(~mask & 0xFFFF) << 16) >> 2);
+    }
+#endif
+    while (k > 0 && ampl[k - 1] == 0)
+        --k;
+    return k - 1;
+}
 
 //******************************************************************************
 bool InterfaceROOT::Initialise(const std::string& file_name, int verbose) {
 //******************************************************************************
-    std::cout << "Initialise ROOT interface" << std::endl;
     _verbose = verbose;
-    _file_in = TFile::Open(file_name.c_str());
+    if (_verbose >= 0)
+        std::cout << "Initialise ROOT interface" << std::endl;
+    _file_in = OpenRootFile(file_name);
     _tree_in = (TTree*)_file_in->Get("tree");
-    _use511 = false;
 
     _t2k.loadMapping();
 
     TString branch_name = _tree_in->GetBranch("PadAmpl")->GetTitle();
 
+    // one buffer sized for the layout of the file
     if (branch_name.Contains("[510]")) {
-        _tree_in->SetBranchAddress("PadAmpl", _padAmpl);
+        _stride = n::samples;
     } else if (branch_name.Contains("[511]")) {
-        _use511 = true;
-        _tree_in->SetBranchAddress("PadAmpl", _padAmpl_511);
+        _stride = 511;
     } else {
         std::cerr << "ERROR in InterfaceROOT::Initialise()" << std::endl;
         exit(1);
     }
+    _padAmpl.assign(geom::nPadx * geom::nPady * _stride, 0);
+    _tree_in->SetBranchAddress("PadAmpl", _padAmpl.data());
+    _amplBranch = _tree_in->GetBranch("PadAmpl");
 
-    if (_tree_in->GetBranch("Tracker")) {
+    _trackerBranch = _tree_in->GetBranch("Tracker");
+    if (_trackerBranch) {
         _has_tracker = true;
-        std::cout << "Has tracker" << std::endl;
+        if (_verbose >= 0)
+            std::cout << "Has tracker" << std::endl;
         _tree_in->SetBranchAddress("Tracker", _pos);
     }
-    std::cout << "Input read" << std::endl;
+
+    std::vector<std::string> branches;
+    if (_root.readEvent)
+        branches.emplace_back("PadAmpl");
+    if (_root.readTracker && _has_tracker)
+        branches.emplace_back("Tracker");
+    SetupTree(_tree_in, branches);
+    if (_verbose >= 0)
+        std::cout << "Input read" << std::endl;
 
     return true;
 }
@@ -48,38 +118,57 @@ uint64_t InterfaceROOT::Scan(int start, bool refresh, int& Nevents_run) {
 //******************************************************************************
 TRawEvent* InterfaceROOT::GetEvent(long int id) {
 //******************************************************************************
-    _tree_in->GetEntry(id);
     auto event = new TRawEvent(id);
-    event->SetTime(_time_mid, _time_msb, _time_lsb);
+    ReadEvent(id, *event);
+    return event;
+}
+
+//******************************************************************************
+bool InterfaceROOT::ReadEvent(long int id, TRawEvent& event) {
+//******************************************************************************
+    return FillEvent(id, event);
+}
+
+//******************************************************************************
+bool InterfaceROOT::ReadEvent(long int id, CompactEvent& event) {
+//******************************************************************************
+    return FillEvent(id, event);
+}
+
+//******************************************************************************
+template<typename Event>
+bool InterfaceROOT::FillEvent(long int id, Event& event) {
+//******************************************************************************
+    // the entry is loaded for the cache, only the amplitudes are read
+    _tree_in->LoadTree(id);
+    _amplBranch->GetEntry(id);
+    ResetEvent(event, id);
+    event.SetTime(_time_mid, _time_msb, _time_lsb);
 
     for (int i = 0; i < geom::nPadx; ++i) {
         for (int j = 0; j < geom::nPady; ++j) {
-            auto hit = new TRawHit();
-            hit->SetCard(0);
+            const int* ampl = _padAmpl.data() + (i * geom::nPady + j) * _stride;
+            // empty pads are skipped before any hit is created
+            if (!HasSignal(ampl, n::samples))
+                continue;
+            // the hit spans the non-zero samples only
+            int first = FirstNonZero(ampl, n::samples);
+            int last = LastNonZero(ampl, n::samples);
             auto elec = _t2k.getElectronics(i, j);
-            hit->SetChip(elec.first);
-            hit->SetChannel(elec.second);
-            hit->ResetWF();
-            auto max = 0;
-            for (int t = 0; t < n::samples; ++t) {
-                auto ampl = _use511 ? _padAmpl_511[i][j][t] : _padAmpl[i][j][t];
-                hit->SetADCunit(t, ampl);
-                if (ampl > max)
-                    max = ampl;
-            }
-            if (max > 0) {
-                hit->ShrinkWF();
-                event->AddHit(hit);
-            } else {
-                delete hit;
-            }
+            AddHit(event, 0, elec.first, elec.second, first, ampl + first, last - first + 1);
         }
     }
-    return event;
+    return true;
 }
 
+//******************************************************************************
 void InterfaceROOT::GetTrackerEvent(long int id, Float_t* pos) {
-    _tree_in->GetEntry(id);
+//******************************************************************************
+    // 8 floats, the amplitude array is not read again
+    if (!_trackerBranch)
+        throw std::logic_error("No tracker info in the file");
+    _tree_in->LoadTree(id);
+    _trackerBranch->GetEntry(id);
     for (int i = 0; i < 8; ++i)
         pos[i] = _pos[i];
 }
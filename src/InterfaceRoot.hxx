@@ -7,6 +7,8 @@
 
 #include "InterfaceBase.hxx"
 
+#include <vector>
+
 /// ROOT file reader
 class InterfaceROOT : public InterfaceBase {
  public:
@@ -14,21 +16,34 @@ class InterfaceROOT : public InterfaceBase {
     ~InterfaceROOT() override = default;
     bool Initialise(const std::string &file_name, int verbose) override;
     uint64_t Scan(int start, bool refresh, int &Nevents_run) override;
+    using InterfaceBase::GetEvent;
     TRawEvent *GetEvent(long int id) override;
     void GetTrackerEvent(long int id, Float_t *pos) override;
 
+ protected:
+    bool ReadEvent(long int id, TRawEvent &event) override;
+    /// The amplitudes go to the 16-bit samples of the compact event without a TRawHit
+    bool ReadEvent(long int id, CompactEvent &event) override;
+
  private:
     TFile *_file_in;
     TTree *_tree_in;
-    int _padAmpl[geom::nPadx][geom::nPady][n::samples];
-    int _padAmpl_511[geom::nPadx][geom::nPady][511];
-    bool _use511;
+    /// PadAmpl and Tracker branches, read separately by GetEvent and GetTrackerEvent
+    TBranch *_amplBranch{nullptr};
+    TBranch *_trackerBranch{nullptr};
+    /// PadAmpl array of the entry, [nPadx][nPady][_stride] with 510 or 511 time bins
+    std::vector<int> _padAmpl;
+    int _stride{n::samples};
     int _time_mid;
     int _time_msb;
     int _time_lsb;
 
     Float_t _pos[8];
     Mapping _t2k;
+
+    /// Build the hits of the non-empty pads of the entry into a TRawEvent or CompactEvent
+    template<typename Event>
+    bool FillEvent(long int id, Event& event);
 };
 
 #endif //DAQ_READER_SRC_INTERFACEROOT_HXX_
@@ -0,0 +1,507 @@
+#include "MidasFileReader.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "mlz4.h"
+
+static const uint32_t kLz4Magic = 0x184D2204;
+/// the 16 magic numbers of the skippable frames differ by the last 4 bits
+static const uint32_t kSkippableMagic = 0x184D2A50;
+/// Linked LZ4 blocks refer to at most the last 64 kB of data
+static const size_t kDictionary = 64 << 10;
+/// Size of the reads of the files that are not LZ4 compressed
+static const size_t kChunk = 1 << 20;
+
+static bool HasSuffix(const std::string& name, const std::string& suffix) {
+    return name.size() >= suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//******************************************************************************
+MidasFileReader::MidasFileReader(const std::string& file_name, const ReadAheadOptions& io)
+    : _fileName(file_name), _io(io) {
+//******************************************************************************
+    if (HasSuffix(file_name, ".lz4"))
+        _format = kLz4;
+    else if (HasSuffix(file_name, ".gz") || HasSuffix(file_name, ".bz2"))
+        _format = kOther;
+    Open();
+}
+
+//******************************************************************************
+MidasFileReader::~MidasFileReader() {
+//******************************************************************************
+    Drain();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+    Close();
+}
+
+//******************************************************************************
+int MidasFileReader::Close() {
+//******************************************************************************
+    if (_file)
+        fclose(_file);
+    _file = nullptr;
+    _ahead.reset();
+    delete _inner;
+    _inner = nullptr;
+    return 0;
+}
+
+//******************************************************************************
+bool MidasFileReader::Open() {
+//******************************************************************************
+    Drain();
+    Close();
+    fError = false;
+    fErrorString.clear();
+    _rawPos = 0;
+    _position = 0;
+    _outPos = _outEnd = 0;
+    _inFrame = false;
+
+    if (_format == kOther) {
+        _inner = TMNewReader(_fileName.c_str());
+        if (_inner->fError)
+            return Fail(_inner->fErrorString);
+        return true;
+    }
+    if (_io.depth > 0) {
+        _ahead.reset(new ReadAhead(_io));
+        if (!_ahead->Open(_fileName))
+            return Fail(std::string("cannot be opened: ") + strerror(errno));
+    } else {
+        _file = fopen(_fileName.c_str(), "rb");
+        if (!_file)
+            return Fail(std::string("cannot be opened: ") + strerror(errno));
+    }
+    return true;
+}
+
+//******************************************************************************
+bool MidasFileReader::Fail(const std::string& message) {
+//******************************************************************************
+    if (!fError)
+        std::cerr << _fileName << ": " << message << std::endl;
+    fError = true;
+    fErrorString = message;
+    return false;
+}
+
+//******************************************************************************
+void MidasFileReader::SetCheckpoints(std::vector<MidasCheckpoint>* checkpoints, bool record) {
+//******************************************************************************
+    _checkpoints = checkpoints;
+    _record = record && checkpoints;
+}
+
+//******************************************************************************
+long MidasFileReader::ReadRaw(void* buf, size_t count) {
+//******************************************************************************
+    long rd;
+    if (_ahead) {
+        rd = _ahead->Read(buf, count);
+    } else {
+        rd = fread(buf, 1, count, _file);
+        if (rd == 0 && ferror(_file))
+            rd = -1;
+    }
+    if (rd > 0)
+        _rawPos += rd;
+    return rd;
+}
+
+//******************************************************************************
+bool MidasFileReader::SeekRaw(uint64_t offset) {
+//******************************************************************************
+    // the checksums are skipped without dropping the buffered data
+    if (offset >= _rawPos && offset - _rawPos <= 16) {
+        char skipped[16];
+        auto n = offset - _rawPos;
+        return n == 0 || ReadRaw(skipped, n) == (long)n;
+    }
+    bool ok = _ahead ? _ahead->Seek(offset) : fseeko(_file, offset, SEEK_SET) == 0;
+    if (ok)
+        _rawPos = offset;
+    return ok;
+}
+
+//******************************************************************************
+bool MidasFileReader::ReadFrameHeader() {
+//******************************************************************************
+    unsigned char descriptor[2];
+    if (ReadRaw(descriptor, 2) != 2)
+        return Fail("truncated LZ4 frame header");
+    if ((descriptor[0] >> 6) != 1)
+        return Fail("unsupported LZ4 frame version");
+    _linked = !(descriptor[0] & 0x20);
+    _blockChecksum = descriptor[0] & 0x10;
+    _contentChecksum = descriptor[0] & 0x04;
+    // optional content size and dictionary id, then the header checksum
+    size_t extra = ((descriptor[0] & 0x08) ? 8 : 0) + ((descriptor[0] & 0x01) ? 4 : 0) + 1;
+    if (!SeekRaw(_rawPos + extra))
+        return Fail("truncated LZ4 frame header");
+    int size_id = (descriptor[1] >> 4) & 0x7;
+    if (size_id < 4)
+        return Fail("invalid LZ4 block size");
+    _blockMax = size_t(1) << (8 + 2 * size_id);
+    if (_in.size() < _blockMax)
+        _in.resize(_blockMax);
+    if (_out.size() < kDictionary + _blockMax)
+        _out.resize(kDictionary + _blockMax);
+    _inFrame = true;
+
+    _parallel = !_linked && _io.threads > 1;
+    _frameEnd = false;
+    if (_parallel && _workers.empty()) {
+        // a few blocks per worker keep them busy while the oldest one is consumed
+        _slots.resize(2 * _io.threads);
+        for (int i = 0; i < _io.threads; ++i)
+            _workers.emplace_back(&MidasFileReader::Work, this);
+    }
+    return true;
+}
+
+//******************************************************************************
+bool MidasFileReader::NextBlock() {
+//******************************************************************************
+    if (fError)
+        return false;
+    if (_format == kLz4) {
+        size_t direct;
+        return NextLz4Block(nullptr, 0, direct);
+    }
+    if (_out.size() < kChunk)
+        _out.resize(kChunk);
+    long rd = _format == kOther ? _inner->Read(_out.data(), kChunk) : ReadRaw(_out.data(), kChunk);
+    if (rd < 0)
+        return Fail("read error");
+    _outPos = 0;
+    _outEnd = rd;
+    return rd > 0;
+}
+
+//******************************************************************************
+bool MidasFileReader::NextLz4Block(char* target, size_t capacity, size_t& direct) {
+//******************************************************************************
+    direct = 0;
+    while (true) {
+        if (!_inFrame) {
+            auto frame_offset = _rawPos;
+            uint32_t magic;
+            auto rd = ReadRaw(&magic, 4);
+            if (rd == 0)
+                return false;
+            if (rd != 4)
+                return Fail("truncated LZ4 frame");
+            if ((magic & 0xFFFFFFF0) == kSkippableMagic) {
+                uint32_t size;
+                if (ReadRaw(&size, 4) != 4 || !SeekRaw(_rawPos + size))
+                    return Fail("truncated skippable frame");
+                continue;
+            }
+            if (magic != kLz4Magic)
+                return Fail("not an LZ4 frame");
+            if (!ReadFrameHeader())
+                return false;
+            _frameOffset = frame_offset;
+            _frameStart = true;
+            // a frame starts without history
+            _outPos = _outEnd = 0;
+        }
+
+        if (_parallel) {
+            int got = NextParallelBlock();
+            if (got < 0)
+                return false;
+            if (got > 0)
+                return true;
+            _inFrame = false;
+            continue;
+        }
+
+        auto block_offset = _rawPos;
+        uint32_t size;
+        if (ReadRaw(&size, 4) != 4)
+            return Fail("truncated LZ4 block");
+        if (size == 0) {
+            // end mark of the frame
+            _inFrame = false;
+            if (_contentChecksum && !SeekRaw(_rawPos + 4))
+                return Fail("truncated LZ4 frame");
+            continue;
+        }
+        bool stored = size & 0x80000000;
+        size &= 0x7FFFFFFF;
+        if (size > _blockMax)
+            return Fail("LZ4 block larger than the frame block size");
+
+        // the history used by the linked blocks is kept in front of the new block
+        size_t keep = _linked ? std::min(_outEnd, kDictionary) : 0;
+        memmove(_out.data(), _out.data() + _outEnd - keep, keep);
+
+        Record(block_offset, _out.data(), keep);
+
+        // a block that surely fits in the target is decoded there without a copy
+        bool in_place = target && capacity >= _blockMax;
+        char* dst = in_place ? target : _out.data() + keep;
+        long n;
+        if (stored) {
+            n = ReadRaw(dst, size);
+            if (n != (long)size)
+                return Fail("truncated LZ4 block");
+        } else {
+            if (ReadRaw(_in.data(), size) != (long)size)
+                return Fail("truncated LZ4 block");
+            n = MLZ4_decompress_safe_usingDict(_in.data(), dst, size, _blockMax, _out.data(), keep);
+            if (n < 0)
+                return Fail("corrupted LZ4 block");
+        }
+        if (_blockChecksum && !SeekRaw(_rawPos + 4))
+            return Fail("truncated LZ4 block");
+
+        if (in_place) {
+            // the history of the next block is the end of the data decoded in place
+            size_t history = _linked ? std::min(keep + n, kDictionary) : 0;
+            size_t from_block = std::min<size_t>(n, history);
+            size_t from_history = history - from_block;
+            memmove(_out.data(), _out.data() + keep - from_history, from_history);
+            memcpy(_out.data() + from_history, dst + n - from_block, from_block);
+            _outPos = _outEnd = history;
+            direct = n;
+        } else {
+            _outPos = keep;
+            _outEnd = keep + n;
+        }
+        if (n > 0)
+            return true;
+    }
+}
+
+//******************************************************************************
+void MidasFileReader::Record(uint64_t block_offset, const char* history, size_t size) {
+//******************************************************************************
+    if (_record) {
+        bool fresh = _checkpoints->empty() || _position > _checkpoints->back().data_offset;
+        bool due = _frameStart || _checkpoints->empty() ||
+            _position >= _checkpoints->back().data_offset + kCheckpointInterval;
+        if (fresh && due)
+            _checkpoints->push_back({block_offset, _position, _frameOffset, std::string(history, size)});
+    }
+    _frameStart = false;
+}
+
+//******************************************************************************
+int MidasFileReader::NextParallelBlock() {
+//******************************************************************************
+    while (true) {
+        // the compressed blocks are read in advance as long as there is a free slot
+        while (!_frameEnd && _submitted - _taken < _slots.size()) {
+            auto block_offset = _rawPos;
+            uint32_t size;
+            if (ReadRaw(&size, 4) != 4) {
+                Fail("truncated LZ4 block");
+                return -1;
+            }
+            if (size == 0) {
+                _frameEnd = true;
+                if (_contentChecksum && !SeekRaw(_rawPos + 4)) {
+                    Fail("truncated LZ4 frame");
+                    return -1;
+                }
+                break;
+            }
+            auto& slot = _slots[_submitted % _slots.size()];
+            slot.stored = size & 0x80000000;
+            slot.size = size & 0x7FFFFFFF;
+            if (slot.size > _blockMax) {
+                Fail("LZ4 block larger than the frame block size");
+                return -1;
+            }
+            if (slot.in.size() < _blockMax)
+                slot.in.resize(_blockMax);
+            if (slot.out.size() < _blockMax)
+                slot.out.resize(_blockMax);
+            if (ReadRaw(slot.in.data(), slot.size) != (long)slot.size) {
+                Fail("truncated LZ4 block");
+                return -1;
+            }
+            if (_blockChecksum && !SeekRaw(_rawPos + 4)) {
+                Fail("truncated LZ4 block");
+                return -1;
+            }
+            slot.file_offset = block_offset;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                slot.done = false;
+                _queue.push_back(&slot);
+                ++_busy;
+            }
+            _work.notify_one();
+            ++_submitted;
+        }
+        if (_submitted == _taken)
+            return 0;
+
+        auto& slot = _slots[_taken % _slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _decoded.wait(lock, [&slot] { return slot.done; });
+        }
+        ++_taken;
+        if (slot.decoded < 0) {
+            Fail("corrupted LZ4 block");
+            return -1;
+        }
+        Record(slot.file_offset, _out.data(), 0);
+        // the decoded block becomes the output, the slot gets the previous output buffer
+        std::swap(_out, slot.out);
+        _outPos = 0;
+        _outEnd = slot.decoded;
+        if (_outEnd > 0)
+            return 1;
+    }
+}
+
+//******************************************************************************
+void MidasFileReader::Drain() {
+//******************************************************************************
+    std::unique_lock<std::mutex> lock(_mutex);
+    // the blocks not taken by a worker yet are dropped
+    for (auto slot : _queue)
+        slot->done = true;
+    _busy -= _queue.size();
+    _queue.clear();
+    _decoded.wait(lock, [this] { return _busy == 0; });
+    _submitted = _taken = 0;
+    _frameEnd = false;
+}
+
+//******************************************************************************
+void MidasFileReader::Work() {
+//******************************************************************************
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _work.wait(lock, [this] { return _stop || !_queue.empty(); });
+        if (_stop)
+            return;
+        Slot* slot = _queue.front();
+        _queue.pop_front();
+        lock.unlock();
+
+        long n = slot->size;
+        if (slot->stored)
+            memcpy(slot->out.data(), slot->in.data(), slot->size);
+        else
+            n = MLZ4_decompress_safe(slot->in.data(), slot->out.data(), slot->size, slot->out.size());
+
+        lock.lock();
+        slot->decoded = n;
+        slot->done = true;
+        --_busy;
+        _decoded.notify_all();
+    }
+}
+
+//******************************************************************************
+int MidasFileReader::Read(void* buf, int count) {
+//******************************************************************************
+    if (fError)
+        return -1;
+    char* dst = static_cast<char*>(buf);
+    size_t done = 0;
+    while (done < (size_t)count) {
+        if (_outPos == _outEnd) {
+            // large reads skip the intermediate buffer
+            size_t direct = 0;
+            if (_format == kLz4) {
+                if (!NextLz4Block(dst + done, count - done, direct))
+                    break;
+            } else if (_format == kPlain && count - done >= kChunk) {
+                long rd = ReadRaw(dst + done, count - done);
+                if (rd < 0)
+                    Fail("read error");
+                if (rd <= 0)
+                    break;
+                direct = rd;
+            } else if (!NextBlock()) {
+                break;
+            }
+            _position += direct;
+            done += direct;
+            continue;
+        }
+        auto n = std::min(_outEnd - _outPos, (size_t)count - done);
+        memcpy(dst + done, _out.data() + _outPos, n);
+        _outPos += n;
+        _position += n;
+        done += n;
+    }
+    if (done == 0 && fError)
+        return -1;
+    return (int)done;
+}
+
+//******************************************************************************
+bool MidasFileReader::Skip(uint64_t n) {
+//******************************************************************************
+    while (n > 0) {
+        if (_outPos == _outEnd && !NextBlock())
+            return false;
+        auto step = std::min<uint64_t>(_outEnd - _outPos, n);
+        _outPos += step;
+        _position += step;
+        n -= step;
+    }
+    return true;
+}
+
+//******************************************************************************
+bool MidasFileReader::Seek(uint64_t offset) {
+//******************************************************************************
+    if (offset >= _position && offset - _position <= kCheckpointInterval)
+        return Skip(offset - _position);
+
+    if (_format == kPlain) {
+        fError = false;
+        if (!SeekRaw(offset))
+            return Fail("cannot seek");
+        _position = offset;
+        _outPos = _outEnd = 0;
+        return true;
+    }
+
+    const MidasCheckpoint* checkpoint = nullptr;
+    if (_format == kLz4 && _checkpoints)
+        checkpoint = MidasIndex::Find(*_checkpoints, offset);
+    // the decoding continues if it is already past the nearest restart point
+    if (offset >= _position && (!checkpoint || checkpoint->data_offset <= _position))
+        return Skip(offset - _position);
+    if (!checkpoint)
+        return Open() && Skip(offset);
+
+    fError = false;
+    Drain();
+    uint32_t magic;
+    if (!SeekRaw(checkpoint->frame_offset) || ReadRaw(&magic, 4) != 4 || magic != kLz4Magic)
+        return Fail("LZ4 frame expected at the checkpoint");
+    if (!ReadFrameHeader())
+        return false;
+    if (!SeekRaw(checkpoint->file_offset))
+        return Fail("cannot seek");
+    _frameOffset = checkpoint->frame_offset;
+    _frameStart = false;
+    std::copy(checkpoint->dictionary.begin(), checkpoint->dictionary.end(), _out.begin());
+    _outPos = _outEnd = checkpoint->dictionary.size();
+    _position = checkpoint->data_offset;
+    return Skip(offset - _position);
+}
@@ -0,0 +1,128 @@
+#ifndef DAQ_READER_SRC_MIDASFILEREADER_HXX_
+#define DAQ_READER_SRC_MIDASFILEREADER_HXX_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midasio.h"
+#include "MidasIndex.hxx"
+#include "ReadAhead.hxx"
+
+/// midasio reader of a midas file that can move to any offset of the data.
+/// The LZ4 frames are decoded block by block so the decoding can restart at the
+/// block owning an offset. The .gz and .bz2 files are read with the midasio
+/// readers and only moving forward is cheap for them.
+/// With io.threads > 1 the frames of independent blocks are decoded in parallel:
+/// the compressed blocks are read ahead into a ring of slots, decoded by the
+/// worker threads and handed out in the file order. Linked blocks depend on the
+/// previous one and stay decoded by the reading thread.
+class MidasFileReader : public TMReaderInterface {
+ public:
+    MidasFileReader(const std::string& file_name, const ReadAheadOptions& io);
+    ~MidasFileReader() override;
+    int Read(void* buf, int count) override;
+    int Close() override;
+
+    /// Offset in the decompressed data of the next byte to be read
+    uint64_t Position() const { return _position; }
+    /// Use the checkpoints to move in the data. With record, the blocks met while
+    /// reading are appended at each LZ4 frame and every kCheckpointInterval bytes
+    void SetCheckpoints(std::vector<MidasCheckpoint>* checkpoints, bool record);
+    /// Continue reading at the offset in the decompressed data
+    bool Seek(uint64_t offset);
+    /// Move forward in the decompressed data without copying it, false if the data ends before
+    bool Skip(uint64_t n);
+
+    /// Decompressed bytes between two recorded checkpoints
+    static const uint64_t kCheckpointInterval = 4 << 20;
+
+ private:
+    enum Format { kPlain, kLz4, kOther };
+
+    /// Open the file and read from its beginning
+    bool Open();
+    /// Read the file itself, compressed or not
+    long ReadRaw(void* buf, size_t count);
+    bool SeekRaw(uint64_t offset);
+    /// Read the LZ4 frame descriptor that follows the magic number
+    bool ReadFrameHeader();
+    /// Decode the next chunk of data into _out, false at the end of the data
+    bool NextBlock();
+    /// Decode the next LZ4 block, straight into target if capacity holds a whole block
+    //! \param direct the number of bytes written to target, the data is in _out when it is 0
+    bool NextLz4Block(char* target, size_t capacity, size_t& direct);
+    /// Append a checkpoint at the block if it is due
+    void Record(uint64_t block_offset, const char* history, size_t size);
+    bool Fail(const std::string& message);
+
+    /// Submit the following blocks of the frame and take the oldest decoded one into _out
+    //! \return 1 for a block, 0 at the end of the frame, -1 on error
+    int NextParallelBlock();
+    /// Wait for the workers and forget the blocks read in advance
+    void Drain();
+    void Work();
+
+    std::string _fileName;
+    ReadAheadOptions _io;
+    Format _format{kPlain};
+
+    FILE* _file{nullptr};
+    std::unique_ptr<ReadAhead> _ahead;
+    TMReaderInterface* _inner{nullptr};
+    /// offset in the file of the next byte of _file or _ahead
+    uint64_t _rawPos{0};
+
+    /// decompressed data, for LZ4 it starts with the history of the linked blocks
+    std::vector<char> _out;
+    size_t _outPos{0};
+    size_t _outEnd{0};
+    uint64_t _position{0};
+    std::vector<char> _in;
+
+    /// current LZ4 frame
+    bool _inFrame{false};
+    bool _frameStart{false};
+    bool _linked{false};
+    bool _blockChecksum{false};
+    bool _contentChecksum{false};
+    size_t _blockMax{0};
+    uint64_t _frameOffset{0};
+
+    std::vector<MidasCheckpoint>* _checkpoints{nullptr};
+    bool _record{false};
+
+    /// compressed block read in advance and its decoded data
+    struct Slot {
+        std::vector<char> in;
+        std::vector<char> out;
+        uint32_t size{0};
+        bool stored{false};
+        uint64_t file_offset{0};
+        long decoded{0};
+        bool done{true};
+    };
+    /// the current frame is decoded by the workers
+    bool _parallel{false};
+    /// the end mark of the frame is read, the ring only has to be emptied
+    bool _frameEnd{false};
+    std::vector<Slot> _slots;
+    /// number of blocks submitted and taken, the ring holds the ones in between
+    uint64_t _submitted{0};
+    uint64_t _taken{0};
+    std::vector<std::thread> _workers;
+    std::deque<Slot*> _queue;
+    /// slots queued or being decoded
+    int _busy{0};
+    bool _stop{false};
+    std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _decoded;
+};
+
+#endif //DAQ_READER_SRC_MIDASFILEREADER_HXX_
@@ -0,0 +1,135 @@
+#include "MidasIndex.hxx"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kMagic[8] = {'M', 'I', 'D', 'I', 'D', 'X', '0', '1'};
+
+struct MidasIndex::Header {
+    char magic[8];
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t n_checkpoints;
+    uint64_t n_events;
+};
+
+/// Fixed part of a stored checkpoint, followed by the dictionary
+struct StoredCheckpoint {
+    uint64_t file_offset;
+    uint64_t data_offset;
+    uint64_t frame_offset;
+    uint64_t dictionary_size;
+};
+
+//******************************************************************************
+bool MidasIndex::Load(const std::string& data_file,
+                      std::vector<MidasCheckpoint>& checkpoints,
+                      std::vector<uint64_t>& events) {
+//******************************************************************************
+    struct stat st{};
+    if (stat(data_file.c_str(), &st) != 0)
+        return false;
+
+    FILE* f = fopen(GetName(data_file).c_str(), "rb");
+    if (!f)
+        return false;
+
+    Header header{};
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.file_size == (uint64_t)st.st_size &&
+        header.mtime_sec == (int64_t)st.st_mtim.tv_sec &&
+        header.mtime_nsec == (int64_t)st.st_mtim.tv_nsec;
+
+    if (ok) {
+        checkpoints.resize(header.n_checkpoints);
+        for (auto& checkpoint : checkpoints) {
+            StoredCheckpoint stored{};
+            ok = fread(&stored, sizeof(stored), 1, f) == 1 && stored.dictionary_size <= (64 << 10);
+            if (!ok)
+                break;
+            checkpoint.file_offset = stored.file_offset;
+            checkpoint.data_offset = stored.data_offset;
+            checkpoint.frame_offset = stored.frame_offset;
+            checkpoint.dictionary.resize(stored.dictionary_size);
+            if (stored.dictionary_size > 0)
+                ok = fread(&checkpoint.dictionary[0], stored.dictionary_size, 1, f) == 1;
+            if (!ok)
+                break;
+        }
+    }
+    if (ok) {
+        events.resize(header.n_events);
+        if (header.n_events > 0)
+            ok = fread(events.data(), sizeof(uint64_t), header.n_events, f) == header.n_events;
+    }
+    fclose(f);
+
+    if (!ok) {
+        checkpoints.clear();
+        events.clear();
+    }
+    return ok;
+}
+
+//******************************************************************************
+bool MidasIndex::Save(const std::string& data_file,
+                      const std::vector<MidasCheckpoint>& checkpoints,
+                      const std::vector<uint64_t>& events) {
+//******************************************************************************
+    struct stat st{};
+    if (stat(data_file.c_str(), &st) != 0)
+        return false;
+
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.file_size = st.st_size;
+    header.mtime_sec = st.st_mtim.tv_sec;
+    header.mtime_nsec = st.st_mtim.tv_nsec;
+    header.n_checkpoints = checkpoints.size();
+    header.n_events = events.size();
+
+    // same scheme as the AQS index: a temporary file with a unique name is moved in place
+    auto name = GetName(data_file);
+    auto tmp_name = name + ".tmp" + std::to_string(getpid());
+    FILE* f = fopen(tmp_name.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (const auto& checkpoint : checkpoints) {
+        if (!ok)
+            break;
+        StoredCheckpoint stored{checkpoint.file_offset,
+                                checkpoint.data_offset,
+                                checkpoint.frame_offset,
+                                checkpoint.dictionary.size()};
+        ok = fwrite(&stored, sizeof(stored), 1, f) == 1;
+        if (ok && !checkpoint.dictionary.empty())
+            ok = fwrite(checkpoint.dictionary.data(), checkpoint.dictionary.size(), 1, f) == 1;
+    }
+    if (ok && !events.empty())
+        ok = fwrite(events.data(), sizeof(uint64_t), events.size(), f) == events.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), name.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+//******************************************************************************
+const MidasCheckpoint* MidasIndex::Find(const std::vector<MidasCheckpoint>& checkpoints, uint64_t offset) {
+//******************************************************************************
+    auto next = std::upper_bound(checkpoints.begin(), checkpoints.end(), offset,
+                                 [](uint64_t value, const MidasCheckpoint& checkpoint) {
+                                     return value < checkpoint.data_offset;
+                                 });
+    if (next == checkpoints.begin())
+        return nullptr;
+    return &*(next - 1);
+}
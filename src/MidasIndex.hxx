@@ -0,0 +1,45 @@
+#ifndef DAQ_READER_SRC_MIDASINDEX_HXX_
+#define DAQ_READER_SRC_MIDASINDEX_HXX_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Point where the decoding of a midas file can restart.
+/// For an LZ4 compressed file it is the start of a block, for the other files
+/// it is only the offset in the data.
+struct MidasCheckpoint {
+    /// byte offset of the block in the file
+    uint64_t file_offset{0};
+    /// offset of the first byte of the block in the decompressed data
+    uint64_t data_offset{0};
+    /// byte offset of the LZ4 frame owning the block
+    uint64_t frame_offset{0};
+    /// last decompressed bytes before the block, needed only by linked blocks
+    std::string dictionary;
+};
+
+/// Sidecar event index of a midas file stored next to it as <file>.idx
+/// The events are located by their offset in the decompressed data, the owning
+/// LZ4 block is the last checkpoint before this offset. The index is valid as
+/// long as the file size and modification time are unchanged.
+class MidasIndex {
+ public:
+    /// Read the index of the data file, false if there is no valid index
+    static bool Load(const std::string& data_file,
+                     std::vector<MidasCheckpoint>& checkpoints,
+                     std::vector<uint64_t>& events);
+    static bool Save(const std::string& data_file,
+                     const std::vector<MidasCheckpoint>& checkpoints,
+                     const std::vector<uint64_t>& events);
+
+    /// Checkpoint owning the data offset, nullptr if there is none
+    static const MidasCheckpoint* Find(const std::vector<MidasCheckpoint>& checkpoints, uint64_t offset);
+
+    static std::string GetName(const std::string& data_file) { return data_file + ".idx"; }
+
+ private:
+    struct Header;
+};
+
+#endif //DAQ_READER_SRC_MIDASINDEX_HXX_
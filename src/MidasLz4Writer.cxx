@@ -0,0 +1,168 @@
+#include "MidasLz4Writer.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "mlz4.h"
+#include "mlz4hc.h"
+#include "mxxhash.h"
+
+static const uint32_t kLz4Magic = 0x184D2204;
+/// Levels from which LZ4 HC is used
+static const int kHighCompression = 3;
+
+//******************************************************************************
+MidasLz4Writer::MidasLz4Writer(const std::string& file_name, int level, int threads)
+    : _level(level) {
+//******************************************************************************
+    // an existing file is never overwritten
+    _file = fopen(file_name.c_str(), "wbx");
+    if (!_file)
+        return;
+
+    // version 1, independent blocks without checksums, 4 MB blocks
+    unsigned char header[7];
+    memcpy(header, &kLz4Magic, 4);
+    header[4] = 0x60;
+    header[5] = 0x70;
+    header[6] = (XXH32(header + 4, 2, 0) >> 8) & 0xFF;
+    _error = fwrite(header, sizeof(header), 1, _file) != 1;
+
+    // a few blocks per worker keep them busy while the oldest one is written
+    _slots.resize(std::max(2 * threads, 1));
+    _slots[0].in.reserve(kBlockSize);
+    if (threads > 1)
+        for (int i = 0; i < threads; ++i)
+            _workers.emplace_back(&MidasLz4Writer::Work, this);
+}
+
+//******************************************************************************
+MidasLz4Writer::~MidasLz4Writer() {
+//******************************************************************************
+    Close();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+//******************************************************************************
+int MidasLz4Writer::Write(const void* buf, int count) {
+//******************************************************************************
+    if (!_file)
+        return -1;
+    auto src = static_cast<const char*>(buf);
+    size_t done = 0;
+    while (done < (size_t)count) {
+        auto& block = _slots[_submitted % _slots.size()].in;
+        auto n = std::min(kBlockSize - block.size(), (size_t)count - done);
+        block.insert(block.end(), src + done, src + done + n);
+        done += n;
+        if (block.size() == kBlockSize)
+            Submit();
+    }
+    return _error ? -1 : count;
+}
+
+//******************************************************************************
+void MidasLz4Writer::Submit() {
+//******************************************************************************
+    auto& slot = _slots[_submitted % _slots.size()];
+    slot.size = slot.in.size();
+    if (_workers.empty()) {
+        Compress(&slot);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            slot.done = false;
+            _queue.push_back(&slot);
+        }
+        _work.notify_one();
+    }
+    ++_submitted;
+    // the next slot is filled once its previous block is written
+    Flush(_submitted - _written == _slots.size());
+    auto& next = _slots[_submitted % _slots.size()].in;
+    next.clear();
+    next.reserve(kBlockSize);
+}
+
+//******************************************************************************
+bool MidasLz4Writer::Flush(bool wait) {
+//******************************************************************************
+    while (_written < _submitted) {
+        auto& slot = _slots[_written % _slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (wait)
+                _compressed.wait(lock, [&slot] { return slot.done; });
+            else if (!slot.done)
+                break;
+        }
+        wait = false;
+        // a block that doesn't shrink is stored as it is
+        bool stored = slot.compressed <= 0 || (size_t)slot.compressed >= slot.size;
+        uint32_t size = stored ? slot.size | 0x80000000 : slot.compressed;
+        const char* data = stored ? slot.in.data() : slot.out.data();
+        if (!_error)
+            _error = fwrite(&size, 4, 1, _file) != 1 ||
+                fwrite(data, stored ? slot.size : slot.compressed, 1, _file) != 1;
+        ++_written;
+    }
+    return !_error;
+}
+
+//******************************************************************************
+void MidasLz4Writer::Compress(Slot* slot) const {
+//******************************************************************************
+    int bound = MLZ4_compressBound(slot->size);
+    if (slot->out.size() < (size_t)bound)
+        slot->out.resize(bound);
+    if (_level >= kHighCompression)
+        slot->compressed = MLZ4_compress_HC(slot->in.data(), slot->out.data(), slot->size, bound, _level);
+    else
+        slot->compressed = MLZ4_compress_default(slot->in.data(), slot->out.data(), slot->size, bound);
+}
+
+//******************************************************************************
+void MidasLz4Writer::Work() {
+//******************************************************************************
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _work.wait(lock, [this] { return _stop || !_queue.empty(); });
+        if (_stop)
+            return;
+        Slot* slot = _queue.front();
+        _queue.pop_front();
+        lock.unlock();
+
+        Compress(slot);
+
+        lock.lock();
+        slot->done = true;
+        _compressed.notify_all();
+    }
+}
+
+//******************************************************************************
+int MidasLz4Writer::Close() {
+//******************************************************************************
+    if (!_file)
+        return 0;
+    if (!_slots[_submitted % _slots.size()].in.empty())
+        Submit();
+    while (_written < _submitted)
+        Flush(true);
+    uint32_t end_mark = 0;
+    if (!_error)
+        _error = fwrite(&end_mark, 4, 1, _file) != 1;
+    _error = fclose(_file) != 0 || _error;
+    _file = nullptr;
+    if (_error)
+        std::cerr << "Error while writing the Midas file" << std::endl;
+    return _error ? -1 : 0;
+}
@@ -0,0 +1,66 @@
+#ifndef DAQ_READER_SRC_MIDASLZ4WRITER_HXX_
+#define DAQ_READER_SRC_MIDASLZ4WRITER_HXX_
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midasio.h"
+
+/// midasio writer of an LZ4 frame with independent blocks.
+/// The data is cut into blocks of kBlockSize that are compressed by the worker
+/// threads and written in order, so the file is read back by any LZ4 decoder and
+/// its blocks could be decompressed in parallel by MidasFileReader.
+class MidasLz4Writer : public TMWriterInterface {
+ public:
+    /// \param level LZ4 level, from 3 on LZ4 HC is used like by the lz4 tool
+    //! \param threads number of threads compressing the blocks, with 0 or 1 the
+    //! blocks are compressed by the calling thread
+    MidasLz4Writer(const std::string& file_name, int level, int threads);
+    ~MidasLz4Writer() override;
+    int Write(const void* buf, int count) override;
+    /// Write the last block and the end mark of the frame
+    int Close() override;
+    /// The file is created, false if it exists already
+    bool IsOpen() const { return _file != nullptr; }
+
+    /// Block size of the frame, the largest one of the LZ4 frame format
+    static const size_t kBlockSize = 4 << 20;
+
+ private:
+    struct Slot {
+        std::vector<char> in;
+        std::vector<char> out;
+        size_t size{0};
+        int compressed{0};
+        bool done{true};
+    };
+
+    /// Hand the current block to the workers
+    void Submit();
+    /// Write the compressed blocks in order, waiting for the first one if wait
+    bool Flush(bool wait);
+    void Compress(Slot* slot) const;
+    void Work();
+
+    FILE* _file{nullptr};
+    int _level;
+    bool _error{false};
+
+    std::vector<Slot> _slots;
+    /// number of blocks submitted and written, the ring holds the ones in between
+    uint64_t _submitted{0};
+    uint64_t _written{0};
+    std::vector<std::thread> _workers;
+    std::deque<Slot*> _queue;
+    bool _stop{false};
+    std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _compressed;
+};
+
+#endif //DAQ_READER_SRC_MIDASLZ4WRITER_HXX_
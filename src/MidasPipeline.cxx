@@ -0,0 +1,177 @@
+#include "MidasPipeline.hxx"
+
+#include <algorithm>
+#include <limits>
+
+/// Slots of the ring per unpacking thread
+static const size_t kSlotsPerThread = 16;
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t Since(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/// Wait until ready() holds, spinning first, then yielding and finally sleeping.
+/// \return the time waited in ns
+template<typename Condition>
+static uint64_t WaitFor(Condition ready) {
+    if (ready())
+        return 0;
+    auto start = Clock::now();
+    for (int i = 0; !ready(); ++i) {
+        if (i < 16)
+            continue;
+        // the name is parenthesised as platform_spec.h defines a yield() macro
+        if (i < 256)
+            (std::this_thread::yield)();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    return Since(start);
+}
+
+//******************************************************************************
+MidasPipeline::MidasPipeline(const std::string& file_name,
+                             int n_threads,
+                             const ReadAheadOptions& io,
+                             size_t memory)
+    : _fileName(file_name), _io(io), _memory(memory),
+      _nSlots(kSlotsPerThread * std::max(n_threads, 1)),
+      _total(std::numeric_limits<uint64_t>::max()) {
+//******************************************************************************
+    _slots.reset(new Slot[_nSlots]);
+    for (size_t i = 0; i < _nSlots; ++i) {
+        _slots[i].sequence = 3 * i;
+        InterfaceMidas::SelectBanks(_slots[i].raw);
+    }
+    _workers.resize(std::max(n_threads, 1));
+}
+
+//******************************************************************************
+MidasPipeline::~MidasPipeline() {
+//******************************************************************************
+    _stop = true;
+    if (_reader.joinable())
+        _reader.join();
+    for (auto& worker : _workers)
+        if (worker.joinable())
+            worker.join();
+    for (size_t i = 0; i < _nSlots; ++i)
+        delete _slots[i].event;
+}
+
+//******************************************************************************
+void MidasPipeline::Start(uint64_t n_events) {
+//******************************************************************************
+    _nEvents = n_events;
+    _reader = std::thread(&MidasPipeline::Read, this);
+    for (auto& worker : _workers)
+        worker = std::thread(&MidasPipeline::Unpack, this);
+}
+
+//******************************************************************************
+void MidasPipeline::Read() {
+//******************************************************************************
+    // the file itself is read in advance by the thread of the read-ahead engine
+    auto io = _io;
+    io.depth = std::max(io.depth, 4);
+    MidasFileReader reader(_fileName, io);
+
+    uint64_t k = 0;
+    while (!reader.fError && (_nEvents == 0 || k < _nEvents)) {
+        auto& slot = _slots[k % _nSlots];
+        _readStage.blocked += WaitFor([&] {
+            return _stop || slot.sequence.load(std::memory_order_acquire) == 3 * k;
+        });
+        if (_stop)
+            break;
+
+        auto start = Clock::now();
+        bool ok = TMReadEventInto(&reader, slot.raw) && !slot.raw.error;
+        _readStage.busy += Since(start);
+        if (!ok)
+            break;
+
+        // a single event larger than the ceiling still goes through alone
+        slot.bytes = slot.raw.data.size();
+        _readStage.blocked += WaitFor([&] {
+            auto in_flight = _inFlight.load();
+            return _stop || in_flight == 0 || in_flight + slot.bytes <= _memory;
+        });
+        _inFlight += slot.bytes;
+        slot.sequence.store(3 * k + 1, std::memory_order_release);
+        _read.store(++k, std::memory_order_relaxed);
+    }
+    _total.store(k, std::memory_order_release);
+}
+
+//******************************************************************************
+void MidasPipeline::Unpack() {
+//******************************************************************************
+    InterfaceMidas unpacker;
+    while (true) {
+        auto k = _claimed.fetch_add(1);
+        auto& slot = _slots[k % _nSlots];
+        _unpackStage.starved += WaitFor([&] {
+            return _stop || slot.sequence.load(std::memory_order_acquire) == 3 * k + 1 ||
+                k >= _total.load(std::memory_order_acquire);
+        });
+        // the event is published before the total, so it can not be missed
+        if (_stop || slot.sequence.load(std::memory_order_acquire) != 3 * k + 1)
+            return;
+
+        auto start = Clock::now();
+        slot.event = unpacker.Unpack(&slot.raw, k);
+        _unpackStage.busy += Since(start);
+        slot.sequence.store(3 * k + 2, std::memory_order_release);
+        _unpacked.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+//******************************************************************************
+bool MidasPipeline::Next(TRawEvent*& event) {
+//******************************************************************************
+    // the time between two calls is spent by the writer
+    if (_written > 0)
+        _writeStage.busy += Since(_returned);
+
+    auto k = _written;
+    auto& slot = _slots[k % _nSlots];
+    _writeStage.starved += WaitFor([&] {
+        return slot.sequence.load(std::memory_order_acquire) == 3 * k + 2 ||
+            k >= _total.load(std::memory_order_acquire);
+    });
+    if (slot.sequence.load(std::memory_order_acquire) != 3 * k + 2)
+        return false;
+
+    event = slot.event;
+    slot.event = nullptr;
+    _inFlight -= slot.bytes;
+
+    auto read = _read.load(std::memory_order_relaxed);
+    auto unpacked = _unpacked.load(std::memory_order_relaxed);
+    _waitingUnpack += read > unpacked ? read - unpacked : 0;
+    _waitingWrite += unpacked > k + 1 ? unpacked - k - 1 : 0;
+
+    slot.sequence.store(3 * (k + _nSlots), std::memory_order_release);
+    ++_written;
+    _returned = Clock::now();
+    return true;
+}
+
+//******************************************************************************
+void MidasPipeline::Print(std::ostream& out) const {
+//******************************************************************************
+    auto seconds = [](const std::atomic<uint64_t>& ns) { return ns.load() * 1e-9; };
+    auto average = [this](uint64_t sum) { return _written > 0 ? double(sum) / _written : 0.; };
+    out << "Pipeline of " << _workers.size() << " unpacking threads, " << _written << " events" << std::endl;
+    out << "  read and decompress: " << seconds(_readStage.busy) << " s busy, "
+        << seconds(_readStage.blocked) << " s waiting for a free slot or memory" << std::endl;
+    out << "  unpack (all threads): " << seconds(_unpackStage.busy) << " s busy, "
+        << seconds(_unpackStage.starved) << " s waiting for the events" << std::endl;
+    out << "  write: " << seconds(_writeStage.busy) << " s busy, "
+        << seconds(_writeStage.starved) << " s waiting for the events" << std::endl;
+    out << "  ring of " << _nSlots << " slots holds on average " << average(_waitingUnpack)
+        << " events to unpack and " << average(_waitingWrite) << " events to write" << std::endl;
+}
@@ -0,0 +1,83 @@
+#ifndef DAQ_READER_SRC_MIDASPIPELINE_HXX_
+#define DAQ_READER_SRC_MIDASPIPELINE_HXX_
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "InterfaceMidas.hxx"
+
+/// Convert a midas file with a pipeline of threads.
+/// The stages are the read-ahead of the file, the decompression and the framing of
+/// the events, the unpacking of the banks by the worker threads and the writer,
+/// which is the thread calling Next. The events move through a ring of slots
+/// without locks: the sequence number of a slot tells which stage owns it, so the
+/// reader waits for free slots, the workers for read events and the writer for
+/// the next unpacked one in the file order. The reader also waits while the raw
+/// events in flight exceed the memory ceiling.
+class MidasPipeline {
+ public:
+    /// \param memory ceiling of the raw event data in flight, in bytes
+    MidasPipeline(const std::string& file_name, int n_threads, const ReadAheadOptions& io, size_t memory);
+    ~MidasPipeline();
+
+    /// Start reading, n_events = 0 reads the whole file
+    void Start(uint64_t n_events);
+    /// Get the next event in the file order, false at the end of the file.
+    /// The event is nullptr if it can not be unpacked, the caller owns it
+    bool Next(TRawEvent*& event);
+    /// Print the time spent by each stage and the occupancy of the ring
+    void Print(std::ostream& out = std::cout) const;
+
+ private:
+    struct Slot {
+        /// 3k free for the event k, 3k+1 read, 3k+2 unpacked
+        std::atomic<uint64_t> sequence{0};
+        TMEvent raw;
+        TRawEvent* event{nullptr};
+        size_t bytes{0};
+    };
+    /// Time of a stage doing its work and waiting for the neighbours, in ns
+    struct Counters {
+        std::atomic<uint64_t> busy{0};
+        std::atomic<uint64_t> starved{0};
+        std::atomic<uint64_t> blocked{0};
+    };
+
+    void Read();
+    void Unpack();
+
+    std::string _fileName;
+    ReadAheadOptions _io;
+    size_t _memory;
+    uint64_t _nEvents{0};
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _nSlots;
+    std::vector<std::thread> _workers;
+    std::thread _reader;
+
+    /// events read, unpacked, claimed by the workers and given to the writer
+    std::atomic<uint64_t> _read{0};
+    std::atomic<uint64_t> _unpacked{0};
+    std::atomic<uint64_t> _claimed{0};
+    uint64_t _written{0};
+    /// when Next returned the last event
+    std::chrono::steady_clock::time_point _returned;
+    /// number of events of the file, known when the reader stops
+    std::atomic<uint64_t> _total;
+    std::atomic<size_t> _inFlight{0};
+    std::atomic<bool> _stop{false};
+
+    Counters _readStage;
+    Counters _unpackStage;
+    Counters _writeStage;
+    /// sums over the written events of the events waiting for each stage
+    uint64_t _waitingUnpack{0};
+    uint64_t _waitingWrite{0};
+};
+
+#endif //DAQ_READER_SRC_MIDASPIPELINE_HXX_
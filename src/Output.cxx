@@ -2,12 +2,14 @@
 // Created by SERGEY SUVOROV on 13/04/2022.
 //
 
+#include <algorithm>
+
 #include "TTree.h"
 
 #include "Output.hxx"
 
 TString OutputBase::getFileName(const std::string& path, const std::string& file_in) {
-    auto fileName = file_in;
+    auto fileName = file_in == "-" ? std::string("stdin") : file_in;
     while (fileName.find('/') != string::npos)
         fileName = fileName.substr(fileName.find('/') + 1);
     fileName = fileName.substr(0, fileName.find('.'));
@@ -18,9 +20,16 @@ void OutputBase::SetCard(int card) {
     _card = card;
 }
 
+void OutputBase::AddEvent(const CompactEvent& event) {
+    _converted.reset(event.ToRawEvent());
+    AddEvent(_converted.get());
+}
+
 void OutputBase::Fill() {
     _tree->Fill();
-    delete _event;
+    // the converted compact event is deleted by the next one
+    if (_ownEvents && _event != _converted.get())
+        delete _event;
 }
 
 void OutputArray::Initialise(const TString& fileName, bool useTracker) {
@@ -56,13 +65,35 @@ void OutputArray::AddEvent(TRawEvent* event) {
         int x = _t2k.i(hit->GetChip() / n::chips, hit->GetChip() % n::chips, _daq.connector(hit->GetChannel()));
         int y = _t2k.j(hit->GetChip() / n::chips, hit->GetChip() % n::chips, _daq.connector(hit->GetChannel()));
 
-        auto v = hit->GetADCvector();
+        const auto& v = hit->GetADCvector();
         for (auto t = 0; t < v.size(); ++t) {
             _padAmpl[x][y][hit->GetTime() + t] = v[t];
         }
     }
 }
 
+void OutputArray::AddEvent(const CompactEvent& event) {
+    _event = nullptr;
+    _time_mid =  event.GetTimeMid();
+    _time_msb =  event.GetTimeMsb();
+    _time_lsb =  event.GetTimeLsb();
+    memset(_padAmpl, 0, geom::nPadx * geom::nPady * n::samples * (sizeof(Int_t)));
+    for (size_t i = 0; i < event.GetNHits(); ++i) {
+        if (_card >= 0 && _card != event.GetCard(i)) {
+            continue;
+        }
+        auto chip = event.GetChip(i);
+        int x = _t2k.i(chip / n::chips, chip % n::chips, _daq.connector(event.GetChannel(i)));
+        int y = _t2k.j(chip / n::chips, chip % n::chips, _daq.connector(event.GetChannel(i)));
+
+        auto samples = event.GetSamples(i);
+        auto ampl = _padAmpl[x][y] + event.GetTime(i);
+        for (size_t t = 0; t < event.GetLength(i); ++t) {
+            ampl[t] = samples[t];
+        }
+    }
+}
+
 void OutputArray::AddTrackerEvent(const std::vector<float>& TrackerPos) {
     for (float & data : _trackerPos)
         data = -999.;
@@ -115,6 +146,96 @@ void OutputTRawEvent::Finilise() {
 ///////////////////////////
 
 
+OutputMidas::~OutputMidas() {
+    delete _writer;
+}
+
+void OutputMidas::SetCompression(int level, int threads) {
+    _level = level;
+    _threads = threads;
+}
+
+void OutputMidas::Initialise(const TString& fileName, bool useTracker) {
+    _writer = new MidasLz4Writer(fileName.Data(), _level, _threads);
+    if (!_writer->IsOpen()) {
+        std::cerr << "Midas file could not be opened." << std::endl;
+        std::cerr << "File probably exists. Prevent overwriting" << std::endl;
+        exit(1);
+    }
+    if (useTracker)
+        std::cerr << "Tracker info is not stored in the Midas output" << std::endl;
+}
+
+void OutputMidas::AddEvent(TRawEvent* event) {
+    _event = event;
+    ClearBanks(event->GetID(), event->GetTimeMsb(), event->GetTimeMid(), event->GetTimeLsb());
+    for (const auto& hit : event->GetHits()) {
+        const auto& adc = hit->GetADCvector();
+        AddWaveform(hit->GetCard(), hit->GetChip(), hit->GetChannel(), hit->GetTime(), adc, adc.size());
+    }
+}
+
+void OutputMidas::AddEvent(const CompactEvent& event) {
+    _event = nullptr;
+    ClearBanks(event.GetID(), event.GetTimeMsb(), event.GetTimeMid(), event.GetTimeLsb());
+    for (size_t i = 0; i < event.GetNHits(); ++i)
+        AddWaveform(event.GetCard(i), event.GetChip(i), event.GetChannel(i), event.GetTime(i),
+                    event.GetSamples(i), event.GetLength(i));
+}
+
+void OutputMidas::AddTrackerEvent(const std::vector<float>& TrackerPos) {}
+
+void OutputMidas::ClearBanks(uint32_t count, uint16_t tmsb, uint16_t tmid, uint16_t tlsb) {
+    _count = count;
+    _tmsb = tmsb;
+    _tmid = tmid;
+    _tlsb = tlsb;
+    _chid.clear();
+    _tmin.clear();
+    _nadc.clear();
+    _wave.clear();
+}
+
+template<typename T>
+void OutputMidas::AddWaveform(int card, int chip, int channel, int time, const T& adc, size_t size) {
+    uint16_t id = ((card & 0x7) << 11) | ((chip & 0xF) << 7) | (channel & 0x7F);
+    // NADC holds 8 bits, longer waveforms go in consecutive pieces and an empty one in none
+    size_t first = 0;
+    while (first < size) {
+        auto n = std::min<size_t>(size - first, 255);
+        _chid.push_back(id);
+        _tmin.push_back(time + first);
+        _nadc.push_back(n);
+        for (size_t k = first; k < first + n; ++k)
+            _wave.push_back(adc[k]);
+        first += n;
+    }
+}
+
+void OutputMidas::Fill() {
+    uint16_t waveforms = _chid.size();
+    _midasEvent.Init(1, 0, _count, 0, 64 + 4 * _wave.size());
+    _midasEvent.AddBank("COUN", TID_UINT32, (const char*)&_count, sizeof(_count));
+    _midasEvent.AddBank("NWAV", TID_UINT16, (const char*)&waveforms, sizeof(waveforms));
+    _midasEvent.AddBank("TMSB", TID_UINT16, (const char*)&_tmsb, sizeof(_tmsb));
+    _midasEvent.AddBank("TMID", TID_UINT16, (const char*)&_tmid, sizeof(_tmid));
+    _midasEvent.AddBank("TLSB", TID_UINT16, (const char*)&_tlsb, sizeof(_tlsb));
+    _midasEvent.AddBank("CHID", TID_UINT16, (const char*)_chid.data(), 2 * _chid.size());
+    _midasEvent.AddBank("TMIN", TID_UINT16, (const char*)_tmin.data(), 2 * _tmin.size());
+    _midasEvent.AddBank("NADC", TID_UINT8, (const char*)_nadc.data(), _nadc.size());
+    _midasEvent.AddBank("WAVE", TID_UINT16, (const char*)_wave.data(), 2 * _wave.size());
+    TMWriteEvent(_writer, &_midasEvent);
+    if (_ownEvents)
+        delete _event;
+}
+
+void OutputMidas::Finilise() {
+    _writer->Close();
+}
+
+///////////////////////////
+
+
 void OutputText::Initialise(const TString& fileName, bool useTracker) {
 
     _t2k.loadMapping();
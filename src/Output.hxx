@@ -8,11 +8,14 @@
 #include "TFile.h"
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 #include "TRawEvent.hxx"
+#include "CompactEvent.hxx"
 #include "T2KConstants.h"
 #include "Mapping.h"
 #include "DAQ.h"
+#include "MidasLz4Writer.hxx"
 
 /// Output converter interface
 class OutputBase {
@@ -21,10 +24,18 @@ class OutputBase {
     TFile* _file;
     TTree* _tree;
     TRawEvent* _event;
+    bool _ownEvents{true};
+    /// Compact event converted for the outputs of TRawEvent, kept until the next one
+    std::unique_ptr<TRawEvent> _converted;
  public:
     virtual void Initialise(const TString& fileName, bool useTracker) = 0;
     virtual void SetCard(int card);
+    /// Whether Fill deletes the events given to AddEvent, not the ones read into a reused event
+    void SetEventOwner(bool owner) { _ownEvents = owner; }
     virtual void AddEvent(TRawEvent* event) = 0;
+    /// The compact event is read during the call. The array and Midas outputs take it directly,
+    /// the other ones a TRawEvent converted from it
+    virtual void AddEvent(const CompactEvent& event);
     virtual void AddTrackerEvent(const std::vector<float>& TrackerPos) = 0;
     virtual void Fill();
     virtual void Finilise() = 0;
@@ -45,6 +56,7 @@ class OutputArray : public OutputBase{
  public:
     void Initialise(const TString& fileName, bool useTracker) override;
     void AddEvent(TRawEvent* event) override;
+    void AddEvent(const CompactEvent& event) override;
     void AddTrackerEvent(const std::vector<float>& TrackerPos) override;
     void Finilise() override;
 };
@@ -56,11 +68,44 @@ class OutputTRawEvent : public OutputBase {
     const TString branchName = "TRawEvent";
  public:
     void Initialise(const TString& fileName, bool useTracker) override;
+    using OutputBase::AddEvent;
     void AddEvent(TRawEvent* event) override;
     void AddTrackerEvent(const std::vector<float>& TrackerPos) override;
     void Finilise() override;
 };
 
+/// Store output as a Midas .mid.lz4 file with the version 2 banks.
+/// Waveforms longer than 255 samples are split as NADC holds 8 bits.
+/// The tracker info is not stored
+class OutputMidas : public OutputBase {
+    MidasLz4Writer* _writer{nullptr};
+    TMEvent _midasEvent;
+    int _level{1};
+    int _threads{1};
+    std::vector<uint16_t> _chid;
+    std::vector<uint16_t> _tmin;
+    std::vector<uint8_t> _nadc;
+    std::vector<uint16_t> _wave;
+    uint32_t _count{0};
+    uint16_t _tmsb{0};
+    uint16_t _tmid{0};
+    uint16_t _tlsb{0};
+    /// Start the banks of the event
+    void ClearBanks(uint32_t count, uint16_t tmsb, uint16_t tmid, uint16_t tlsb);
+    /// Append the waveform of size samples starting at the time bin time to the banks
+    template<typename T>
+    void AddWaveform(int card, int chip, int channel, int time, const T& adc, size_t size);
+ public:
+    ~OutputMidas();
+    /// LZ4 level, from 3 on LZ4 HC, and the number of threads compressing the blocks
+    void SetCompression(int level, int threads);
+    void Initialise(const TString& fileName, bool useTracker) override;
+    void AddEvent(TRawEvent* event) override;
+    void AddEvent(const CompactEvent& event) override;
+    void AddTrackerEvent(const std::vector<float>& TrackerPos) override;
+    void Fill() override;
+    void Finilise() override;
+};
 
 /// Store output as text file
 class OutputText : public OutputBase{
@@ -72,6 +117,7 @@ class OutputText : public OutputBase{
     int _time_mid, _time_msb, _time_lsb;
 public:
     void Initialise(const TString& fileName, bool useTracker) override;
+    using OutputBase::AddEvent;
     void AddEvent(TRawEvent* event) override;
     void AddTrackerEvent(const std::vector<float>& TrackerPos) override;
     void Fill() override;
@@ -0,0 +1,360 @@
+#include "ReadAhead.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+
+struct ReadAhead::Ring {
+    io_uring ring;
+};
+#endif
+
+/// Alignment of the buffers, offsets and sizes required by O_DIRECT
+static const size_t kPage = 4096;
+
+//******************************************************************************
+ReadAhead::ReadAhead(const ReadAheadOptions& options) : _options(options) {
+//******************************************************************************
+    _options.depth = std::max(_options.depth, 2);
+    _options.blockSize = (std::max(_options.blockSize, kPage) + kPage - 1) / kPage * kPage;
+    _blocks.resize(_options.depth);
+    for (auto& block : _blocks) {
+        void* buf = nullptr;
+        if (posix_memalign(&buf, kPage, _options.blockSize) != 0) {
+            std::cerr << "Read-ahead buffers could not be allocated" << std::endl;
+            exit(1);
+        }
+        block.data = static_cast<char*>(buf);
+    }
+}
+
+//******************************************************************************
+ReadAhead::~ReadAhead() {
+//******************************************************************************
+    Stop();
+#ifdef USE_IO_URING
+    if (_ring) {
+        io_uring_queue_exit(&_ring->ring);
+        delete _ring;
+    }
+#endif
+    for (auto& block : _blocks)
+        free(block.data);
+    if (_ownFd)
+        close(_fd);
+    if (_reader) {
+        _reader->Close();
+        delete _reader;
+    }
+}
+
+//******************************************************************************
+bool ReadAhead::Open(const std::string& file_name) {
+//******************************************************************************
+    if (file_name == "-") {
+        _fd = STDIN_FILENO;
+    } else {
+#ifdef O_DIRECT
+        if (_options.direct) {
+            _fd = open(file_name.c_str(), O_RDONLY | O_DIRECT);
+            _direct = _fd >= 0;
+            if (!_direct)
+                std::cerr << "O_DIRECT is not supported for " << file_name << ", the page cache is used" << std::endl;
+        }
+#endif
+        if (_fd < 0)
+            _fd = open(file_name.c_str(), O_RDONLY);
+        if (_fd < 0)
+            return false;
+        _ownFd = true;
+    }
+
+    struct stat st{};
+    _seekable = fstat(_fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (_seekable && !_direct)
+        posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#ifdef USE_IO_URING
+    if (_seekable) {
+        _ring = new Ring;
+        if (io_uring_queue_init(_blocks.size(), &_ring->ring, 0) < 0) {
+            // not available in this kernel or sandbox, the reader thread is used
+            delete _ring;
+            _ring = nullptr;
+        }
+    }
+#endif
+    Start(0);
+    return true;
+}
+
+//******************************************************************************
+bool ReadAhead::Open(TMReaderInterface* reader) {
+//******************************************************************************
+    _reader = reader;
+    if (_reader->fError) {
+        std::cerr << _reader->fErrorString << std::endl;
+        _error = _eof = true;
+        return false;
+    }
+    Start(0);
+    return true;
+}
+
+//******************************************************************************
+void ReadAhead::Start(uint64_t offset) {
+//******************************************************************************
+    auto aligned = _seekable ? offset / kPage * kPage : offset;
+    _skip = offset - aligned;
+    _readOffset = aligned;
+    _head = _tail = _released = 0;
+    _eof = false;
+    _holding = false;
+    _cur = nullptr;
+    _curSize = _curPos = 0;
+    _curOffset = offset;
+    for (auto& block : _blocks)
+        block.ready = false;
+#ifdef USE_IO_URING
+    if (_ring) {
+        for (size_t slot = 0; slot < _blocks.size(); ++slot)
+            Submit(slot);
+        return;
+    }
+#endif
+    _stop = false;
+    _thread = std::thread(&ReadAhead::Work, this);
+}
+
+//******************************************************************************
+void ReadAhead::Stop() {
+//******************************************************************************
+#ifdef USE_IO_URING
+    if (_ring) {
+        // the buffers may be reused only when the kernel is done with them
+        while (_inflight > 0) {
+            io_uring_cqe* cqe;
+            if (io_uring_wait_cqe(&_ring->ring, &cqe) < 0)
+                break;
+            io_uring_cqe_seen(&_ring->ring, cqe);
+            --_inflight;
+        }
+        return;
+    }
+#endif
+    if (!_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _freed.notify_all();
+    _thread.join();
+}
+
+//******************************************************************************
+long ReadAhead::ReadBlock(char* buf, uint64_t offset, size_t done) {
+//******************************************************************************
+    while (done < _options.blockSize && _reader) {
+        // the decompressed data of the midasio reader
+        auto rd = _reader->Read(buf + done, _options.blockSize - done);
+        if (rd <= 0)
+            return rd < 0 ? -1 : done;
+        done += rd;
+    }
+    while (done < _options.blockSize) {
+        auto rd = _seekable ? pread(_fd, buf + done, _options.blockSize - done, offset + done)
+                            : read(_fd, buf + done, _options.blockSize - done);
+        if (rd < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (rd == 0)
+            break;
+        done += rd;
+        // with O_DIRECT a short read is the end of the file, the next offset is not aligned
+        if (_direct)
+            break;
+    }
+    return done;
+}
+
+//******************************************************************************
+void ReadAhead::Work() {
+//******************************************************************************
+    while (true) {
+        size_t slot;
+        uint64_t offset;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _freed.wait(lock, [this]() { return _stop || _head - _released < _blocks.size(); });
+            if (_stop)
+                return;
+            slot = _head % _blocks.size();
+            offset = _readOffset;
+        }
+        auto& block = _blocks[slot];
+        auto rd = ReadBlock(block.data, offset);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (rd < 0) {
+                _error = true;
+                rd = 0;
+            }
+            block.offset = offset;
+            block.size = rd;
+            _readOffset += rd;
+            ++_head;
+        }
+        _filled.notify_all();
+        // a short block is the last one
+        if ((size_t)rd < _options.blockSize)
+            return;
+    }
+}
+
+#ifdef USE_IO_URING
+//******************************************************************************
+void ReadAhead::Submit(size_t slot) {
+//******************************************************************************
+    auto& block = _blocks[slot];
+    block.ready = false;
+    block.offset = _readOffset;
+    _readOffset += _options.blockSize;
+    auto sqe = io_uring_get_sqe(&_ring->ring);
+    io_uring_prep_read(sqe, _fd, block.data, _options.blockSize, block.offset);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(slot));
+    io_uring_submit(&_ring->ring);
+    ++_inflight;
+}
+#endif
+
+//******************************************************************************
+bool ReadAhead::Fetch() {
+//******************************************************************************
+    if (_eof)
+        return false;
+    Block* block;
+#ifdef USE_IO_URING
+    if (_ring) {
+        // the released buffer is reused for the read furthest ahead
+        if (_holding)
+            Submit((_tail - 1) % _blocks.size());
+        _holding = false;
+        block = &_blocks[_tail % _blocks.size()];
+        while (!block->ready) {
+            io_uring_cqe* cqe;
+            if (io_uring_wait_cqe(&_ring->ring, &cqe) < 0) {
+                _error = true;
+                return false;
+            }
+            auto& done = _blocks[reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe))];
+            long res = cqe->res;
+            io_uring_cqe_seen(&_ring->ring, cqe);
+            --_inflight;
+            if (res < 0) {
+                _error = true;
+                res = 0;
+            } else if ((size_t)res < _options.blockSize && !_direct) {
+                // a short read is not necessarily the end of the file
+                res = ReadBlock(done.data, done.offset, res);
+            }
+            done.size = std::max(res, 0L);
+            done.ready = true;
+        }
+        ++_tail;
+        _holding = true;
+    } else
+#endif
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_holding)
+            ++_released;
+        _holding = false;
+        _freed.notify_all();
+        _filled.wait(lock, [this]() { return _tail < _head; });
+        block = &_blocks[_tail % _blocks.size()];
+        ++_tail;
+        _holding = true;
+    }
+
+    _cur = block->data;
+    _curSize = block->size;
+    _curOffset = block->offset;
+    _curPos = std::min(_skip, _curSize);
+    _skip = 0;
+    if (_curSize < _options.blockSize)
+        _eof = true;
+    return _curSize > 0;
+}
+
+//******************************************************************************
+size_t ReadAhead::Next(const char*& data) {
+//******************************************************************************
+    while (_curPos == _curSize) {
+        if (!Fetch())
+            return 0;
+    }
+    data = _cur + _curPos;
+    auto n = _curSize - _curPos;
+    _curPos = _curSize;
+    return n;
+}
+
+//******************************************************************************
+void ReadAhead::Unread(size_t n) {
+//******************************************************************************
+    _curPos -= std::min(n, _curPos);
+}
+
+//******************************************************************************
+long ReadAhead::Read(void* buf, size_t count) {
+//******************************************************************************
+    size_t copied = 0;
+    while (copied < count) {
+        const char* data;
+        auto n = Next(data);
+        if (n == 0)
+            break;
+        auto take = std::min(n, count - copied);
+        memcpy(static_cast<char*>(buf) + copied, data, take);
+        Unread(n - take);
+        copied += take;
+    }
+    if (copied == 0 && _error)
+        return -1;
+    return copied;
+}
+
+//******************************************************************************
+bool ReadAhead::Seek(uint64_t offset) {
+//******************************************************************************
+    auto position = Position();
+    if (offset >= position && offset - position <= _options.blockSize * _blocks.size()) {
+        // the data is already on its way
+        auto skip = offset - position;
+        while (skip > 0) {
+            if (_curPos == _curSize && !Fetch())
+                break;
+            auto n = std::min<uint64_t>(skip, _curSize - _curPos);
+            _curPos += n;
+            skip -= n;
+        }
+        // the input ended before the offset
+        return skip == 0;
+    }
+    if (!_seekable)
+        return false;
+    Stop();
+    Start(offset);
+    return true;
+}
@@ -0,0 +1,119 @@
+#ifndef DAQ_READER_SRC_READAHEAD_HXX_
+#define DAQ_READER_SRC_READAHEAD_HXX_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midasio.h"
+
+/// Options of the read-ahead engine
+struct ReadAheadOptions {
+    /// number of blocks read in advance, 0 disables the engine
+    int depth{0};
+    /// size of one read in bytes, rounded up to the page size
+    size_t blockSize{4 << 20};
+    /// bypass the page cache with O_DIRECT
+    bool direct{false};
+    /// threads decoding the independent LZ4 blocks of a midas file, with 0 or 1
+    /// the blocks are decoded by the reading thread
+    int threads{0};
+};
+
+/// Read a file sequentially with the reads issued in advance.
+/// The blocks are read by io_uring when the project is built with ENABLE_IO_URING
+/// and the input is a regular file, by a dedicated reader thread otherwise.
+/// The data of a midasio reader is read by the reader thread as well, so the
+/// compressed inputs are decompressed while the previous blocks are decoded.
+class ReadAhead {
+ public:
+    explicit ReadAhead(const ReadAheadOptions& options);
+    ~ReadAhead();
+
+    /// Open the file, "-" stands for the standard input
+    bool Open(const std::string& file_name);
+    /// Read the data given by the midasio reader, e.g. made by TMNewReader. The reader
+    /// is deleted with the engine and only moving forward is possible
+    bool Open(TMReaderInterface* reader);
+    /// Continue reading at the byte offset. Short forward jumps are served from
+    /// the blocks already read, otherwise the reading restarts (regular files only).
+    /// False if the offset could not be reached
+    bool Seek(uint64_t offset);
+    /// Get the rest of the current block or the next one, valid until the next call.
+    /// \return the number of bytes, 0 at the end of the input
+    size_t Next(const char*& data);
+    /// Give back the last n bytes returned by Next
+    void Unread(size_t n);
+    /// Copy up to count bytes, returns the number of bytes copied or -1 on error
+    long Read(void* buf, size_t count);
+
+    /// Byte offset in the input of the next byte to be returned
+    uint64_t Position() const { return _curOffset + _curPos; }
+    bool Error() const { return _error; }
+
+ private:
+    struct Block {
+        char* data{nullptr};
+        size_t size{0};
+        uint64_t offset{0};
+        bool ready{false};
+    };
+
+    /// Release the current block and wait for the next one, false at the end of the input
+    bool Fetch();
+    /// Start reading the blocks at the offset, aligned to the page size
+    void Start(uint64_t offset);
+    /// Stop the reads in flight
+    void Stop();
+    /// Read a whole block, shorter only at the end of the input. The first done bytes are already read
+    long ReadBlock(char* buf, uint64_t offset, size_t done = 0);
+    void Work();
+
+    ReadAheadOptions _options;
+    int _fd{-1};
+    bool _ownFd{false};
+    TMReaderInterface* _reader{nullptr};
+    bool _seekable{false};
+    bool _direct{false};
+    /// set by the reader thread as well
+    std::atomic<bool> _error{false};
+    bool _eof{false};
+
+    std::vector<Block> _blocks;
+    /// blocks produced, taken and given back by the consumer
+    uint64_t _head{0};
+    uint64_t _tail{0};
+    uint64_t _released{0};
+    /// offset of the next read
+    uint64_t _readOffset{0};
+    /// bytes to skip at the beginning of the first block after Start
+    size_t _skip{0};
+
+    /// current block
+    const char* _cur{nullptr};
+    size_t _curSize{0};
+    size_t _curPos{0};
+    uint64_t _curOffset{0};
+    bool _holding{false};
+
+    /// reader thread
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _filled;
+    std::condition_variable _freed;
+    bool _stop{false};
+
+#ifdef USE_IO_URING
+    struct Ring;
+    Ring* _ring{nullptr};
+    /// reads submitted and not completed yet
+    int _inflight{0};
+    void Submit(size_t slot);
+#endif
+};
+
+#endif //DAQ_READER_SRC_READAHEAD_HXX_
@@ -0,0 +1,82 @@
+#include "RootClusterProcessor.hxx"
+#include "InterfaceFactory.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "TROOT.h"
+
+//******************************************************************************
+RootClusterProcessor::RootClusterProcessor(const std::string& file_name,
+                                           int n_threads,
+                                           int verbose,
+                                           const RootReadOptions& root) {
+//******************************************************************************
+    ROOT::EnableThreadSafety();
+    for (int i = 0; i < std::max(n_threads, 1); ++i) {
+        auto interface = InterfaceFactory::get(file_name);
+        if (!std::dynamic_pointer_cast<InterfaceROOT>(interface) &&
+            !std::dynamic_pointer_cast<InterfaceRawEvent>(interface)) {
+            std::cerr << "Only the ROOT files are processed by clusters. Exit" << std::endl;
+            exit(1);
+        }
+        interface->SetRootOptions(root);
+        // only the first interface reports the file
+        if (!interface->Initialise(file_name, i == 0 ? verbose : -1)) {
+            std::cerr << "Interface initialisation fails. Exit" << std::endl;
+            exit(1);
+        }
+        _interfaces.push_back(interface);
+    }
+    _starts = GetClusterStarts(file_name);
+    if (verbose > 0)
+        std::cout << _starts.size() << " clusters processed by " << _interfaces.size() << " threads" << std::endl;
+}
+
+//******************************************************************************
+std::vector<uint64_t> RootClusterProcessor::GetClusterStarts(const std::string& file_name) {
+//******************************************************************************
+    std::vector<uint64_t> starts;
+    std::unique_ptr<TFile> file(TFile::Open(file_name.c_str()));
+    if (!file || file->IsZombie())
+        return starts;
+    auto tree = file->Get<TTree>("EventTree");
+    if (!tree)
+        tree = file->Get<TTree>("tree");
+    if (!tree)
+        return starts;
+    auto cluster = tree->GetClusterIterator(0);
+    for (Long64_t start; (start = cluster.Next()) < tree->GetEntries();)
+        starts.push_back(start);
+    return starts;
+}
+
+//******************************************************************************
+void RootClusterProcessor::Process(const Sink& sink, uint64_t n_events) {
+//******************************************************************************
+    // the entries are read directly from the trees, the other interfaces need no scan
+    int nRun;
+    uint64_t nEntries = _interfaces[0]->Scan(-1, true, nRun);
+    if (n_events == 0 || n_events > nEntries)
+        n_events = nEntries;
+
+    // the clusters are taken one by one by the threads that are free
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned slot = 0; slot < _interfaces.size(); ++slot) {
+        workers.emplace_back([this, &sink, &next, n_events, slot]() {
+            auto interface = _interfaces[slot].get();
+            while (true) {
+                auto k = next++;
+                if (k >= _starts.size() || _starts[k] >= n_events)
+                    return;
+                auto last = k + 1 < _starts.size() ? std::min(_starts[k + 1], n_events) : n_events;
+                for (auto id = _starts[k]; id < last; ++id)
+                    sink(slot, id, interface->GetEvent(id));
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
@@ -0,0 +1,36 @@
+#ifndef DAQ_READER_SRC_ROOTCLUSTERPROCESSOR_HXX_
+#define DAQ_READER_SRC_ROOTCLUSTERPROCESSOR_HXX_
+
+#include "InterfaceBase.hxx"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Process the events of a ROOT input, TRawEvent or 3D array, with several threads.
+/// The tree is cut at its cluster boundaries, so the baskets of a cluster are read and
+/// decompressed by one thread only. Like with TTreeProcessorMT every thread owns its
+/// own interface with its TFile and TTree, the events are handed to the sink by the
+/// thread that read them, in no particular order.
+class RootClusterProcessor {
+ public:
+    /// Called by the worker threads with the index of the thread, the entry number and
+    /// the event. The ownership of the event is passed to the sink
+    using Sink = std::function<void(unsigned slot, long int id, TRawEvent* event)>;
+
+    RootClusterProcessor(const std::string& file_name, int n_threads, int verbose, const RootReadOptions& root = {});
+
+    /// Process the events [0, n_events), all of them with 0, and wait for the workers
+    void Process(const Sink& sink, uint64_t n_events = 0);
+    size_t GetNThreads() const { return _interfaces.size(); }
+
+    /// First entries of the clusters of the EventTree or tree of the file, empty if there is no tree
+    static std::vector<uint64_t> GetClusterStarts(const std::string& file_name);
+
+ private:
+    std::vector<std::shared_ptr<InterfaceBase>> _interfaces;
+    std::vector<uint64_t> _starts;
+};
+
+#endif //DAQ_READER_SRC_ROOTCLUSTERPROCESSOR_HXX_
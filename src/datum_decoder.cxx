@@ -79,17 +79,34 @@
    when building up a decoded string can become equal to the expected size,
    and not pass beyond it by one unit when message size is odd.
 
+   September 2022: (version 1.10) added Datum_DecodeBlock() that decodes a
+   whole buffer of datum and delivers completed items to a sink. The most
+   frequent datum (ADC samples, channel hit headers and time bin indexes) are
+   classified with a table on their most significant byte and decoded in place,
+   all other datum are handed to Datum_Decode(). Consecutive ADC samples of a
+   channel are delivered as a single run.
+
+   September 2022: (version 1.11) added Datum_ScanBlock() that only delivers
+   the items which are not self-contained in one datum (start of event, end of
+   event, frame headers, messages, ...). Runs of ADC samples, channel hit
+   headers, time bin indexes, channel hit counts and last cell read are skipped
+   with SIMD compares when available.
+
 *******************************************************************************/
 
 #include "datum_decoder.h"
 #include "frame.h"
 #include <stdio.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*******************************************************************************
 Manage Major/Minor version numbering manually
 *******************************************************************************/
 #define DECODER_VERSION_MAJOR 1
-#define DECODER_VERSION_MINOR 9
+#define DECODER_VERSION_MINOR 11
 char decoder_date[] = __DATE__;
 char decoder_time[] = __TIME__;
 /******************************************************************************/
@@ -750,6 +767,294 @@ int Datum_Decode(DatumContext *dc, unsigned short datum)
 	return(0);
 }
 
+/*******************************************************************************
+ Datum classes for Datum_DecodeBlock(), indexed by the most significant byte
+ of a datum that is not of implicit type
+*******************************************************************************/
+#define DC_OT 0 // Other datum, decoded by Datum_Decode()
+#define DC_AS 1 // PFX_ADC_SAMPLE
+#define DC_HH 2 // PFX_CARD_CHIP_CHAN_HIT_IX
+#define DC_TB 3 // PFX_TIME_BIN_IX
+
+static const unsigned char DatumClass[256] = {
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_TB, DC_TB, // 0x00 - 0x0F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x10 - 0x1F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x20 - 0x2F
+	DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, DC_AS, // 0x30 - 0x3F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x40 - 0x4F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x50 - 0x5F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x60 - 0x6F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x70 - 0x7F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x80 - 0x8F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0x90 - 0x9F
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0xA0 - 0xAF
+	DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, DC_OT, // 0xB0 - 0xBF
+	DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, // 0xC0 - 0xCF
+	DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, // 0xD0 - 0xDF
+	DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, // 0xE0 - 0xEF
+	DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH, DC_HH // 0xF0 - 0xFF
+};
+
+/*******************************************************************************
+ DatumHistory_Push
+*******************************************************************************/
+static void DatumHistory_Push(DatumContext *dc, const unsigned short *data, unsigned long n)
+{
+	unsigned long i;
+
+	if (n > DATUM_HISTORY_SIZE)
+	{
+		data = data + (n - DATUM_HISTORY_SIZE);
+		n    = DATUM_HISTORY_SIZE;
+	}
+	for (i = 0; i < n; i++)
+	{
+		memmove(&(dc->DatumHistory[1]), &(dc->DatumHistory[0]), (DATUM_HISTORY_SIZE-1) * sizeof(unsigned short));
+		dc->DatumHistory[0] = data[i];
+	}
+}
+
+/*******************************************************************************
+ Datum_DecodeBlock
+*******************************************************************************/
+unsigned long Datum_DecodeBlock(DatumContext *dc, const unsigned short *data, unsigned long n, DatumSink sink, void *user)
+{
+	unsigned long i, j;
+	unsigned short datum;
+	unsigned char cls;
+	int err;
+	DatumItem item;
+
+	i = 0;
+	while (i < n)
+	{
+		datum = data[i];
+		cls   = dc->isDatumTypeImplicit ? DC_OT : DatumClass[datum >> 8];
+
+		item.Error       = 0;
+		item.Position    = i;
+		item.Samples     = NULL;
+		item.SampleCount = 0;
+
+		if (cls == DC_AS)
+		{
+			// Find the end of the run of ADC samples
+			for (j = i + 1; j < n; j++)
+			{
+				if ((data[j] & PFX_12_BIT_CONTENT_MASK) != PFX_ADC_SAMPLE)
+				{
+					break;
+				}
+			}
+			item.ItemType            = IT_ADC_SAMPLE;
+			item.AbsoluteSampleIndex = dc->AbsoluteSampleIndex + 1;
+			item.Samples             = &data[i];
+			item.SampleCount         = (unsigned int) (j - i);
+			// Leave the context as after the last sample of the run
+			dc->AdcSample            = GET_ADC_DATA(data[j-1]);
+			dc->RelativeSampleIndex  = dc->RelativeSampleIndex + item.SampleCount;
+			dc->AbsoluteSampleIndex  = dc->AbsoluteSampleIndex + item.SampleCount;
+			dc->ItemType             = IT_ADC_SAMPLE;
+			dc->isItemComplete       = 1;
+			dc->EventSizeFound       = dc->EventSizeFound + item.SampleCount * sizeof(unsigned short);
+			dc->DatumCount           = dc->DatumCount + item.SampleCount;
+			dc->DatumOkCount         = dc->DatumOkCount + item.SampleCount;
+			DatumHistory_Push(dc, &data[i], j - i);
+			i = j;
+		}
+		else if (cls == DC_HH)
+		{
+			dc->CardIndex           = GET_CARD_IX(datum);
+			dc->ChipIndex           = GET_CHIP_IX(datum);
+			dc->ChannelIndex        = GET_CHAN_IX(datum);
+			dc->ItemType            = IT_CHANNEL_HIT_HEADER;
+			dc->DatumType           = DT_UNKNOWN_O;
+			dc->RelativeSampleIndex = -1;
+			dc->AbsoluteSampleIndex = -1;
+			dc->isItemComplete      = 1;
+			dc->EventSizeFound      = dc->EventSizeFound + sizeof(unsigned short);
+			dc->DatumCount          = dc->DatumCount + 1;
+			dc->DatumOkCount        = dc->DatumOkCount + 1;
+			DatumHistory_Push(dc, &data[i], 1);
+			item.ItemType           = IT_CHANNEL_HIT_HEADER;
+			i++;
+		}
+		else if (cls == DC_TB)
+		{
+			dc->TimeBinIndex        = GET_TIME_BIN(datum);
+			dc->ItemType            = IT_TIME_BIN_INDEX;
+			dc->RelativeSampleIndex = -1;
+			dc->AbsoluteSampleIndex = dc->TimeBinIndex - 1 - dc->SampleIndexOffsetZS;
+			dc->isItemComplete      = 1;
+			dc->EventSizeFound      = dc->EventSizeFound + sizeof(unsigned short);
+			dc->DatumCount          = dc->DatumCount + 1;
+			dc->DatumOkCount        = dc->DatumOkCount + 1;
+			DatumHistory_Push(dc, &data[i], 1);
+			item.ItemType           = IT_TIME_BIN_INDEX;
+			i++;
+		}
+		else
+		{
+			i++;
+			if ((err = Datum_Decode(dc, datum)) < 0)
+			{
+				item.ItemType = IT_UNKNOWN;
+				item.Error    = err;
+			}
+			else if (dc->isItemComplete)
+			{
+				item.ItemType = dc->ItemType;
+			}
+			else
+			{
+				continue;
+			}
+		}
+
+		if (item.SampleCount == 0)
+		{
+			item.AbsoluteSampleIndex = dc->AbsoluteSampleIndex;
+		}
+		if (sink && sink(user, dc, &item))
+		{
+			break;
+		}
+	}
+
+	return(i);
+}
+
+/*******************************************************************************
+ Datum that are a complete item by themselves and can not change the implicit
+ type of the following datum, indexed by the most significant byte:
+ PFX_TIME_BIN_IX, PFX_CHIP_CHAN_HIT_CNT, PFX_CHIP_LAST_CELL_READ,
+ PFX_ADC_SAMPLE and PFX_CARD_CHIP_CHAN_HIT_IX
+*******************************************************************************/
+static const unsigned char DatumSelfContained[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, // 0x00 - 0x0F
+	0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, // 0x10 - 0x1F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20 - 0x2F
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x30 - 0x3F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x40 - 0x4F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x50 - 0x5F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x60 - 0x6F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x70 - 0x7F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80 - 0x8F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90 - 0x9F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xA0 - 0xAF
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xB0 - 0xBF
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xC0 - 0xCF
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xD0 - 0xDF
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xE0 - 0xEF
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 // 0xF0 - 0xFF
+};
+
+/*******************************************************************************
+ Datum_SkipSelfContained
+*******************************************************************************/
+static unsigned long Datum_SkipSelfContained(const unsigned short *data, unsigned long i, unsigned long n)
+{
+#if defined(__SSE2__)
+	const __m128i mask_12 = _mm_set1_epi16((short) PFX_12_BIT_CONTENT_MASK);
+	const __m128i mask_14 = _mm_set1_epi16((short) PFX_14_BIT_CONTENT_MASK);
+	const __m128i pfx_adc = _mm_set1_epi16((short) PFX_ADC_SAMPLE);
+	const __m128i pfx_hit = _mm_set1_epi16((short) PFX_CARD_CHIP_CHAN_HIT_IX);
+	__m128i w, skip;
+	int mask;
+#endif
+
+	while (i < n)
+	{
+#if defined(__SSE2__)
+		// Skip ADC samples and channel hit headers 8 datum at a time
+		while ((i + 8) <= n)
+		{
+			w    = _mm_loadu_si128((const __m128i *) &data[i]);
+			skip = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(w, mask_12), pfx_adc),
+			                    _mm_cmpeq_epi16(_mm_and_si128(w, mask_14), pfx_hit));
+			mask = _mm_movemask_epi8(skip);
+			if (mask != 0xFFFF)
+			{
+				i = i + (__builtin_ctz(~mask & 0xFFFF) >> 1);
+				break;
+			}
+			i = i + 8;
+		}
+#endif
+		if ((i < n) && DatumSelfContained[data[i] >> 8])
+		{
+			i++;
+		}
+		else
+		{
+			break;
+		}
+	}
+	return(i);
+}
+
+/*******************************************************************************
+ Datum_ScanBlock
+*******************************************************************************/
+unsigned long Datum_ScanBlock(DatumContext *dc, const unsigned short *data, unsigned long n, DatumSink sink, void *user)
+{
+	unsigned long i, j;
+	unsigned short datum;
+	int err;
+	DatumItem item;
+
+	item.Samples     = NULL;
+	item.SampleCount = 0;
+
+	i = 0;
+	while (i < n)
+	{
+		if (!dc->isDatumTypeImplicit)
+		{
+			j = Datum_SkipSelfContained(data, i, n);
+			if (j > i)
+			{
+				// Account for the skipped datum as Datum_Decode() would
+				dc->DatumCount     = dc->DatumCount + (unsigned int) (j - i);
+				dc->DatumOkCount   = dc->DatumOkCount + (unsigned int) (j - i);
+				dc->EventSizeFound = dc->EventSizeFound + (unsigned int) ((j - i) * sizeof(unsigned short));
+				DatumHistory_Push(dc, &data[i], j - i);
+				i = j;
+			}
+			if (i == n)
+			{
+				break;
+			}
+		}
+
+		datum         = data[i];
+		item.Error    = 0;
+		item.Position = i;
+		i++;
+		if ((err = Datum_Decode(dc, datum)) < 0)
+		{
+			item.ItemType = IT_UNKNOWN;
+			item.Error    = err;
+		}
+		else if (dc->isItemComplete)
+		{
+			item.ItemType = dc->ItemType;
+		}
+		else
+		{
+			continue;
+		}
+
+		item.AbsoluteSampleIndex = dc->AbsoluteSampleIndex;
+		if (sink && sink(user, dc, &item))
+		{
+			break;
+		}
+	}
+
+	return(i);
+}
+
 /*******************************************************************************
 Item_PrintFilter_Init
 *******************************************************************************/
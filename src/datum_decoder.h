@@ -29,6 +29,11 @@
    April 2020: added members DatumHistory[] and IncompleteItemCount
    in DatumContext structure
 
+   September 2022: defined structure DatumItem, type DatumSink and added
+   function Datum_DecodeBlock()
+
+   September 2022: added function Datum_ScanBlock()
+
 *******************************************************************************/
 
 #ifndef _DATUM_DECODER_H
@@ -188,12 +193,32 @@ typedef struct _PrintFilter {
 	unsigned short SampleAmplMax;
 } PrintFilter;
 
+/* Item delivered by Datum_DecodeBlock(). The values of the item are found in
+   the DatumContext as for Datum_Decode(), except for runs of ADC samples that
+   are described here. */
+typedef struct _DatumItem {
+	ItemTypes             ItemType;
+	int                   Error;               /* Negative error code, 0 if the item is valid */
+	unsigned long         Position;            /* Index in the block of the datum completing the item, of the first sample for runs */
+	short                 AbsoluteSampleIndex; /* Absolute index of the first sample of the run */
+	const unsigned short *Samples;             /* Raw ADC datums of the run, use GET_ADC_DATA() */
+	unsigned int          SampleCount;         /* Number of ADC samples in the run */
+} DatumItem;
+
+/* Called for each completed item. A non-zero return value stops the decoding */
+typedef int (*DatumSink)(void *user, const DatumContext *dc, const DatumItem *item);
+
 /*******************************************************************************
 Function prototypes
 *******************************************************************************/
 void SourceTypeToString(unsigned short st, char *s);
 void DatumContext_Init(DatumContext *dc, unsigned short sample_index_offset_zs);
 int Datum_Decode(DatumContext *dc, unsigned short datum);
+unsigned long Datum_DecodeBlock(DatumContext *dc, const unsigned short *data, unsigned long n, DatumSink sink, void *user);
+/* Same as Datum_DecodeBlock() but only the items spanning several datum or
+   starting an implicit sequence are delivered. Sample, channel and time bin
+   fields of the context are not updated for the skipped datum. */
+unsigned long Datum_ScanBlock(DatumContext *dc, const unsigned short *data, unsigned long n, DatumSink sink, void *user);
 void Item_PrintFilter_Init(PrintFilter *pf);
 int Item_Print(void *fp, DatumContext *dc, PrintFilter *pf);
 